@@ -0,0 +1,320 @@
+// Microbenchmarks for the core POS routines on deterministic synthetic data.
+//
+//   g++ -std=c++17 -O2 -pthread bench/pos_bench.cpp -o pos_bench
+//   ./pos_bench [--sizes=10000,1000000] [--members=N] [--products=N] [--seed=N] [--dir=PATH]
+//
+// One JSON object per result line on stdout, e.g.
+//   {"bench":"hasCourtClash","bookings":10000,"iterations":1000000,"total_ms":41.2,"ns_per_op":41.2}
+// Data files are written to --dir (default: <temp>/pos_bench), never to the
+// working directory. 10M bookings needs several GB of RAM.
+
+#define POS_NO_MAIN
+#include "../src/main.cpp"
+
+#include <array>
+
+namespace bench {
+
+// splitmix64: small, fast and identical on every platform
+struct Rng {
+    uint64_t s;
+    explicit Rng(uint64_t seed) : s(seed) {}
+    uint64_t next() {
+        uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    int below(int n) { return (int)(next() % (uint64_t)n); }
+    bool chance(int percent) { return below(100) < percent; }
+};
+
+struct Config {
+    vector<long> sizes = { 10000, 1000000 };
+    long members = 0;  // 0 = bookings / 20
+    int products = 200;
+    uint64_t seed = 42;
+    string dir;
+};
+
+ostream* results = nullptr;
+volatile long sink = 0; // keeps benchmarked results alive
+
+string phoneFor(long i) {
+    string digits = to_string(100000000L + i);
+    return "0" + digits;
+}
+
+const DayNum FIRST_DAY = dayFromCivil(1, 1, 2023);
+
+void resetStore() {
+    members.clear();
+    inventory.clear();
+    allBookings.clear();
+    bookingSegments.clear();
+    feedbackList.clear();
+    otherItemNames.clear();
+    currentSession->cartItems.clear();
+    currentSession->cartCents = 0;
+    nextBookingID = 1001;
+}
+
+// N members, M products and K bookings spread over three years. Roughly half
+// the bills carry a court slot, the rest are entries, rentals, lockers and
+// shop items, with one to four lines per bill.
+void generate(const Config& cfg, long bookings) {
+    resetStore();
+    Rng rng(cfg.seed);
+
+    long memberCount = cfg.members > 0 ? cfg.members : max(1L, bookings / 20);
+    members.reserve(memberCount);
+    for (long i = 0; i < memberCount; i++) {
+        Member m;
+        m.name = "Member " + to_string(i);
+        m.phone = phoneFor(i);
+        m.type = rng.chance(50) ? "6 Months" : "12 Months";
+        m.joinDate = FIRST_DAY + rng.below(3 * 365);
+        m.expiryDate = m.joinDate;
+        members.push_back(m);
+    }
+
+    loadDefaultsInventory();
+    for (int i = (int)inventory.size(); i < cfg.products; i++) {
+        inventory.push_back({ 1000 + i, "Synthetic Item " + to_string(i), 100 + rng.below(5000), 1000000 });
+    }
+    rebuildProductCatalog();
+
+    const int days = 3 * 365;
+
+    allBookings.reserve(bookings);
+    for (long i = 0; i < bookings; i++) {
+        // Bookings arrive in date order, like a real history
+        int day = (int)((double)i / bookings * days);
+        DayNum date = FIRST_DAY + day;
+        bool weekend = isWeekend(date);
+
+        BookingRecord b;
+        b.bookingID = nextBookingID++;
+        if (rng.chance(40) && !members.empty()) {
+            const Member& m = members[rng.below((int)members.size())];
+            b.customerName = customerStrings.intern(m.name);
+            b.customerPhone = customerStrings.intern(m.phone);
+        }
+        else {
+            b.customerName = customerStrings.intern("Walk-in " + to_string(i % 1000));
+            b.customerPhone = customerStrings.intern(phoneFor(memberCount + rng.below(100000)));
+        }
+
+        if (rng.chance(50)) {
+            LineItem it;
+            it.kind = ItemKind::Booking;
+            it.refId = rng.below(3);
+            it.court = (int16_t)rng.below(FACILITIES[it.refId].courts);
+            it.date = date;
+            it.slotStart = (int16_t)((10 + rng.below(11)) * 60);
+            it.slotEnd = (int16_t)(it.slotStart + 60 * (1 + rng.below(2)));
+            if (it.slotEnd > 22 * 60) it.slotEnd = 22 * 60;
+            it.unitCents = courtPriceCents(it.refId, weekend, it.slotEnd - it.slotStart);
+            b.items.push_back(it);
+        }
+        else if (rng.chance(30)) {
+            LineItem it;
+            it.kind = ItemKind::Booking;
+            it.refId = 3 + rng.below(3);
+            it.date = date;
+            it.slotStart = (int16_t)(OPEN_MINUTE + rng.below(ENTRY_SESSIONS) * ENTRY_SESSION_MINUTES);
+            it.slotEnd = (int16_t)(it.slotStart + ENTRY_SESSION_MINUTES);
+            it.unitCents = entryPriceCents(it.refId, weekend);
+            b.items.push_back(it);
+        }
+
+        int extras = rng.below(4);
+        for (int e = 0; e < extras || b.items.empty(); e++) {
+            LineItem it;
+            int pick = rng.below(10);
+            if (pick < 3) {
+                it.kind = ItemKind::Rental;
+                it.refId = rng.below(RENTAL_COUNT);
+                it.qty = 1 + rng.below(2);
+                it.unitCents = RENTALS[it.refId].priceCents;
+            }
+            else if (pick < 4) {
+                it.kind = ItemKind::Locker;
+                it.refId = rng.below(LOCKER_COUNT);
+                it.unitCents = LOCKERS[it.refId].priceCents;
+            }
+            else {
+                const Product& p = inventory[rng.below((int)inventory.size())];
+                it.kind = ItemKind::Product;
+                it.refId = p.id;
+                it.qty = 1 + rng.below(3);
+                it.unitCents = p.priceCents;
+            }
+            appendLine(b.items, it);
+        }
+
+        Cents cents = 0;
+        for (const auto& it : b.items) cents += it.lineCents();
+        b.totalCents = cents + percentOf(cents, 6);
+        b.day = date;
+        b.minute = (int16_t)((rng.chance(50) ? 11 : 18) * 60 + (rng.chance(50) ? 5 : 40));
+        allBookings.push_back(b);
+    }
+}
+
+void report(const string& name, long bookings, long iterations, chrono::steady_clock::duration elapsed) {
+    double ms = chrono::duration<double, milli>(elapsed).count();
+    double nsPerOp = chrono::duration<double, nano>(elapsed).count() / max(1L, iterations);
+    *results << "{\"bench\":\"" << name << "\",\"bookings\":" << bookings
+        << ",\"iterations\":" << iterations
+        << fixed << setprecision(3) << ",\"total_ms\":" << ms << ",\"ns_per_op\":" << nsPerOp << "}\n";
+    results->flush();
+}
+
+template <typename Fn>
+void timeIt(const string& name, long bookings, long iterations, Fn&& fn) {
+    auto t0 = chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) fn(i);
+    report(name, bookings, iterations, chrono::steady_clock::now() - t0);
+}
+
+void runSize(const Config& cfg, long bookings) {
+    generate(cfg, bookings);
+    rebuildMemberIndex();
+    rebuildBookingIndexes();
+
+    // Persistence
+    remove(FILE_SNAPSHOT);
+    remove(FILE_JOURNAL);
+    timeIt("saveData", bookings, 1, [](long) { saveData(); });
+
+    resetStore();
+    timeIt("loadData_text", bookings, 1, [](long) { loadData(); });
+    sink += (long)allBookings.size();
+
+    timeIt("writeSnapshot", bookings, 1, [](long) { writeSnapshot(); });
+    resetStore();
+    timeIt("loadData_snapshot", bookings, 1, [](long) { loadData(); });
+    sink += (long)allBookings.size();
+    // The generated history is in past months, so startup loaded only headers;
+    // full reports read their figures, "everything" reads the records
+    timeIt("loadColdReportFigures", bookings, 1, [](long) { loadColdReportFigures(); });
+    sink += (long)dailyAgg.size();
+    timeIt("loadAllBookingSegments", bookings, 1, [](long) { loadAllBookingSegments(); });
+    sink += (long)allBookings.size();
+
+    // Lookups, with queries drawn up front so only the lookup is timed
+    Rng rng(cfg.seed + 1);
+    const long queries = 1000000;
+
+    vector<LineItem> probes;
+    for (const auto& b : allBookings) {
+        for (const auto& it : b.items) if (it.isCourt()) probes.push_back(it);
+        if (probes.size() >= 4096) break;
+    }
+    vector<array<int, 5>> clashQueries(4096);
+    for (auto& q : clashQueries) {
+        const LineItem& p = probes.empty() ? LineItem() : probes[rng.below((int)probes.size())];
+        int start = (10 + rng.below(11)) * 60;
+        int facility = rng.below(3);
+        q = { facility, rng.below(FACILITIES[facility].courts), p.date, start, start + 60 };
+    }
+    timeIt("hasCourtClash", bookings, queries, [&](long i) {
+        const auto& q = clashQueries[i & 4095];
+        sink += hasCourtClash(q[0], q[1], q[2], q[3], q[4]);
+    });
+    timeIt("pickCourt", bookings, queries, [&](long i) {
+        const auto& q = clashQueries[i & 4095];
+        sink += pickCourt(q[0], q[2], q[3], q[4]);
+    });
+
+    timeIt("findFreeCourtSlots", bookings, queries / 10, [&](long i) {
+        sink += (long)findFreeCourtSlots(clashQueries[i & 4095][2], 60).size();
+    });
+
+    vector<string> phones(4096);
+    for (auto& p : phones) p = phoneFor(rng.below((int)members.size() * 2)); // about half are misses
+    timeIt("findMemberSlot", bookings, queries, [&](long i) { sink += findMemberSlot(phones[i & 4095]); });
+
+    // Item parsing: legacy free text and the typed format that replaced it
+    vector<string> legacy(1024), typed(1024);
+    for (int i = 0; i < 1024; i++) {
+        const BookingRecord& b = allBookings[rng.below((int)allBookings.size())];
+        const LineItem& it = b.items[rng.below((int)b.items.size())];
+        ostringstream os;
+        writeLineItem(os, it);
+        typed[i] = os.str();
+
+        DayNum date = probes.empty() ? FIRST_DAY : probes[i % probes.size()].date;
+        int start = 10 + rng.below(11);
+        legacy[i] = string("Booking: ") + FACILITIES[rng.below(3)].name + " [" + dateString(date) + " "
+            + to_string(start * 100) + "-" + to_string((start + 1) * 100) + "]";
+    }
+    timeIt("parseCourtBookingItem", bookings, queries, [&](long i) {
+        string f, d;
+        int s = 0, e = 0;
+        sink += parseCourtBookingItem(legacy[i & 1023], f, d, s, e) ? s : 0;
+    });
+    timeIt("upgradeLegacyItem", bookings, queries, [&](long i) { sink += upgradeLegacyItem(legacy[i & 1023]).refId; });
+    timeIt("readLineItem", bookings, queries, [&](long i) { sink += readLineItem(typed[i & 1023]).refId; });
+
+    // Reports
+    timeIt("rebuildReportAggregates", bookings, 1, [](long) { rebuildReportAggregates(); });
+    timeIt("generateDailyReports", bookings, 1, [](long) { generateDailyReports(); });
+    timeIt("generateMonthlyReports", bookings, 1, [](long) { generateMonthlyReports(); });
+    vector<const SalesAggregate*> months;
+    for (const auto& kv : monthlyAgg) months.push_back(&kv.second);
+    timeIt("topSellers", bookings, 10000, [&](long i) {
+        sink += (long)topSellers(*months[i % months.size()], ItemKind::Product, 10).size();
+    });
+    timeIt("salesBetween", bookings, queries, [&](long i) {
+        DayNum from = clashQueries[i & 4095][2];
+        sink += salesBetween(from, from + (int)(i & 63)).transactions;
+    });
+    timeIt("bookingSlotsOnDay", bookings, 1000, [&](long i) {
+        sink += (long)bookingSlotsOnDay(clashQueries[i & 4095][2]).size();
+    });
+    sink += (long)dailyReports.size() + (long)monthlyReports.size();
+}
+
+vector<long> parseSizes(const string& s) {
+    vector<long> out;
+    stringstream ss(s);
+    string part;
+    while (getline(ss, part, ',')) {
+        long v = atol(part.c_str());
+        if (v > 0) out.push_back(v);
+    }
+    return out;
+}
+
+} // namespace bench
+
+int main(int argc, char** argv) {
+    bench::Config cfg;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (startsWith(arg, "--sizes=")) cfg.sizes = bench::parseSizes(arg.substr(8));
+        else if (startsWith(arg, "--members=")) cfg.members = atol(arg.c_str() + 10);
+        else if (startsWith(arg, "--products=")) cfg.products = atoi(arg.c_str() + 11);
+        else if (startsWith(arg, "--seed=")) cfg.seed = strtoull(arg.c_str() + 7, nullptr, 10);
+        else if (startsWith(arg, "--dir=")) cfg.dir = arg.substr(6);
+        else {
+            cerr << "Unknown option: " << arg << "\n";
+            return 2;
+        }
+    }
+
+    filesystem::path dir = cfg.dir.empty() ? filesystem::temp_directory_path() / "pos_bench" : filesystem::path(cfg.dir);
+    filesystem::create_directories(dir);
+    filesystem::current_path(dir);
+
+    // Results go to stdout; the POS code's own console output is dropped
+    ostream out(cout.rdbuf());
+    bench::results = &out;
+    cout.rdbuf(nullptr);
+
+    persistenceEnabled = false;
+    for (long n : cfg.sizes) bench::runSize(cfg, n);
+    return 0;
+}
@@ -8,56 +8,176 @@
 #include <string>
 #include <iomanip>
 #include <fstream>
+#include <sstream>
+#include <cmath>
 #include <limits>
 #include <ctime>
 #include <map>
+#include <set>
 #include <algorithm>
 #include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <string_view>
+#include <memory>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <cerrno>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
 // ================= DATA STRUCTURES =================
+// Calendar day, 1 = 01/01/1900 (see DATE / TIME HELPERS)
+using DayNum = int32_t;
+const DayNum NO_DATE = 0;
+
+// Money in sen (RM 0.01), see MONEY
+using Cents = int64_t;
+
 struct Member {
     string name;
     string phone;
     string type;       // "6 Months" or "12 Months"
-    string joinDate;   // "DD/MM/YYYY"
-    string expiryDate; // Calculated
+    DayNum joinDate = NO_DATE;
+    DayNum expiryDate = NO_DATE; // Calculated
 };
 
 struct Product {
     int id;
     string name;
-    double price;
+    Cents priceCents;
     int stock;
 };
 
+// Fixed catalog of things sold at the counter (product ids live in inventory)
+struct FacilityDef {
+    const char* name;
+    bool hourly;        // court (priced per hour, needs a time slot) vs per entry
+    int weekdayCents;
+    int weekendCents;
+    int courts;         // numbered courts of this type (hourly only)
+    int capacity;       // people per entry session, 0 = no limit (per entry only)
+};
+
+const int MAX_COURTS = 8;
+
+const FacilityDef FACILITIES[] = {
+    { "Badminton Court",      true,  1500, 2000, 6,  0 },
+    { "Pickleball Court",     true,  1500, 2000, 4,  0 },
+    { "Basketball Court",     true,  4000, 5000, 2,  0 },
+    { "Swimming Pool Entry",  false,  500,  800, 0, 40 },
+    { "Gym Room Entry",       false, 1000, 1000, 0, 20 },
+    { "Fitness Studio Entry", false, 3000, 3000, 0, 10 },
+};
+
+struct RentalDef {
+    const char* name;
+    int priceCents;
+    int depositPerUnit; // RM, 0 = no deposit
+};
+
+const RentalDef RENTALS[] = {
+    { "Badminton Racket", 1000, 30 },
+    { "Paddle",            800, 30 },
+    { "Basketball",       1000, 30 },
+    { "Resistance Band",   500,  0 },
+    { "Yoga Mat",          500,  0 },
+};
+
+struct LockerDef {
+    const char* name;
+    int priceCents;
+};
+
+const LockerDef LOCKERS[] = {
+    { "Small",   500 },
+    { "Medium",  800 },
+    { "Large",  1000 },
+};
+
+const int FACILITY_COUNT = (int)(sizeof(FACILITIES) / sizeof(FACILITIES[0]));
+const int RENTAL_COUNT = (int)(sizeof(RENTALS) / sizeof(RENTALS[0]));
+const int LOCKER_COUNT = (int)(sizeof(LOCKERS) / sizeof(LOCKERS[0]));
+
+enum class ItemKind : uint8_t {
+    Booking, // refId = FACILITIES index
+    Rental,  // refId = RENTALS index
+    Locker,  // refId = LOCKERS index
+    Product, // refId = Product.id
+    Other    // refId = otherItemNames index (legacy text we could not map)
+};
+
+// One cart / bill line. Dates are day numbers, slot times minutes of day.
+struct LineItem {
+    ItemKind kind = ItemKind::Other;
+    int32_t refId = 0;
+    int32_t qty = 1;
+    Cents unitCents = 0;
+    DayNum date = NO_DATE; // booking date (Booking only)
+    int16_t slotStart = 0; // court slot or entry session [start, end) in minutes (Booking only)
+    int16_t slotEnd = 0;
+    int16_t court = 0;     // 0-based court number within the facility (hourly Booking only)
+
+    Cents lineCents() const { return unitCents * qty; }
+    bool isCourt() const {
+        return kind == ItemKind::Booking && refId >= 0 && refId < FACILITY_COUNT && FACILITIES[refId].hourly;
+    }
+};
+
+// Handle into a StringPool; 0 is the empty string
+using StrId = uint32_t;
+
 struct BookingRecord {
     int bookingID;
-    string customerName;
-    string customerPhone;
-    double totalAmount;
-    string dateStr; // "DD/MM/YYYY HH:MM"
-    vector<string> items;
+    StrId customerName = 0;  // customerStrings handles
+    StrId customerPhone = 0;
+    Cents totalCents = 0;
+    DayNum day = NO_DATE; // sale date
+    int16_t minute = 0;   // sale time, minutes of day
+    vector<LineItem> items;
+    bool cancelled = false; // tombstone until the next compaction
 };
 
 struct DailyReport {
-    string date; // "DD/MM/YYYY"
+    DayNum date = NO_DATE;
     int totalTransactions = 0;
-    double totalSales = 0.0;
+    Cents salesCents = 0;
     string bestBooking = "-";
     string bestRental = "-";
     string bestProduct = "-";
 };
 
 struct MonthlyReport {
-    string month; // "YYYY-MM"
+    int month = 0; // monthIndexOf
     int totalTransactions = 0;
-    double totalSales = 0.0;
+    Cents salesCents = 0;
     string bestBooking = "-";
     string bestRental = "-";
     string bestProduct = "-";
-    double highestIncome = 0.0;
+    Cents highestBillCents = 0;
 };
 
 // ================= GLOBAL VARIABLES =================
@@ -68,17 +188,247 @@ vector<BookingRecord> allBookings;
 vector<DailyReport> dailyReports;
 vector<MonthlyReport> monthlyReports;
 
-int nextBookingID = 1001;
+// Lanes take booking IDs from here in blocks of BOOKING_ID_BLOCK
+atomic<int> nextBookingID{ 1001 };
+const int BOOKING_ID_BLOCK = 16;
+
+// Guards everything shared between POS lanes: the vectors above, the
+// indexes built on them and the journal. The POS OPERATIONS functions take
+// it; the console menus only run while they are the only lane.
+mutex storeMutex;
+
+// Legacy item text that did not match anything in the catalog
+vector<string> otherItemNames;
+
+struct PendingCommit;
+
+// One POS lane (the console, a replay script, ...): its own cart and the
+// booking IDs it has reserved but not used yet.
+struct PosSession {
+    vector<LineItem> cartItems;
+    Cents cartCents = 0;
+    int nextId = 0, idEnd = 0; // reserved booking IDs [nextId, idEnd)
+    // Set for daemon clients: a sale or refund does not wait for its journal
+    // flush but is left in heldCommit for the event loop to settle.
+    bool deferCommits = false;
+    shared_ptr<PendingCommit> heldCommit;
+};
 
-// Cart
-vector<string> currentCartItems;
-double currentCartTotal = 0.0;
+PosSession consoleSession;
+thread_local PosSession* currentSession = &consoleSession;
 
 // Files
 const char* FILE_MEMBERS = "members.txt";
 const char* FILE_INVENTORY = "inventory.txt";
-const char* FILE_BOOKINGS = "bookings.txt";
+const char* FILE_BOOKINGS = "bookings.txt";          // legacy single file, imported into segments
+const char* DIR_BOOKING_SEGMENTS = "bookings";        // one file per sale month, see BOOKING SEGMENTS
 const char* FILE_FEEDBACKS = "feedbacks.txt";
+const char* FILE_SNAPSHOT = "pos.snap";
+
+// ================= STRING POOL =================
+// Append-only arena of interned strings. Each distinct string is stored once,
+// length-prefixed and NUL-terminated, in chunks that never move, so a StrId
+// and a view of it stay valid for the life of the process. Customer names and
+// phones repeat across thousands of bookings; records keep 4-byte handles
+// instead of two 32-byte strings each. The index is an open-addressed table of
+// (hash, id) words rather than a node map, so a distinct string costs its
+// bytes plus ~24 bytes of bookkeeping. Guarded by storeMutex like the store.
+class StringPool {
+public:
+    StringPool() { entries.push_back(store(string_view())); }
+
+    StrId intern(string_view s) {
+        if (s.empty()) return 0;
+        if ((entries.size() + 1) * 2 > slots.size()) grow();
+        uint32_t h = hashOf(s);
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            uint64_t slot = slots[i];
+            if (slot == 0) {
+                StrId id = (StrId)entries.size();
+                entries.push_back(store(s));
+                slots[i] = ((uint64_t)h << 32) | id;
+                return id;
+            }
+            if ((uint32_t)(slot >> 32) == h && view((StrId)slot) == s) return (StrId)slot;
+        }
+    }
+
+    string_view view(StrId id) const {
+        if (id >= entries.size()) return {};
+        uint32_t len;
+        memcpy(&len, entries[id] - sizeof(len), sizeof(len));
+        return { entries[id], len };
+    }
+
+    size_t size() const { return entries.size(); }
+
+private:
+    static constexpr size_t CHUNK_BYTES = 64 * 1024;
+
+    static uint32_t hashOf(string_view s) {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (unsigned char c : s) h = (h ^ c) * 16777619u;
+        return h;
+    }
+
+    // Copies s into the arena and returns a pointer to its first byte
+    const char* store(string_view s) {
+        uint32_t len = (uint32_t)s.size();
+        size_t need = sizeof(len) + s.size() + 1;
+        if (chunks.empty() || chunkUsed + need > chunkSize) {
+            chunkSize = max(CHUNK_BYTES, need);
+            chunks.emplace_back(new char[chunkSize]);
+            chunkUsed = 0;
+        }
+        char* p = chunks.back().get() + chunkUsed;
+        memcpy(p, &len, sizeof(len));
+        if (!s.empty()) memcpy(p + sizeof(len), s.data(), s.size()); // data() may be null
+        p[sizeof(len) + s.size()] = '\0';
+        chunkUsed += (need + 3) & ~(size_t)3; // keep length prefixes aligned
+        return p + sizeof(len);
+    }
+
+    void grow() {
+        vector<uint64_t> old(max<size_t>(slots.size() * 2, 1024), 0);
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (uint64_t slot : old) {
+            if (slot == 0) continue;
+            size_t i = (slot >> 32) & mask;
+            while (slots[i] != 0) i = (i + 1) & mask;
+            slots[i] = slot;
+        }
+    }
+
+    vector<unique_ptr<char[]>> chunks;
+    size_t chunkUsed = 0, chunkSize = 0;
+    vector<const char*> entries; // by StrId
+    vector<uint64_t> slots;      // hash << 32 | id, 0 = empty
+};
+
+// Booking customer names and phones
+StringPool customerStrings;
+
+inline string_view customerText(StrId id) { return customerStrings.view(id); }
+
+// ================= METRICS =================
+// Always-on latency histograms and counters. A histogram keeps 16 linear
+// sub-buckets per power of two (HDR style, <= 6.25% error), so recording is a
+// couple of shifts and one relaxed atomic add.
+const char* FILE_METRICS = "metrics.txt";
+const int METRICS_DUMP_EVERY_SECONDS = 60;
+
+enum class Metric { Checkout, Refund, SaveData, LoadData, Snapshot, JournalAppend, ClashCheck, ReportRebuild, ReportBuild, SegmentLoad, JournalFlush, COUNT };
+
+const char* METRIC_NAMES[] = {
+    "checkout", "refund", "save_data", "load_data", "snapshot", "journal_append", "clash_check", "report_rebuild", "report_build",
+    "segment_load", "journal_flush"
+};
+
+struct LatencyHistogram {
+    static const int SUB_BITS = 4;
+    static const int SUB = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB; // covers every uint64_t
+
+    atomic<uint64_t> counts[BUCKETS] = {};
+    atomic<uint64_t> total{ 0 };
+    atomic<uint64_t> sumNs{ 0 };
+    atomic<uint64_t> maxNs{ 0 };
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < (uint64_t)SUB) return (int)ns;
+        int msb = 63;
+        while (!(ns >> msb)) msb--;
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB + (int)((ns >> shift) & (SUB - 1));
+    }
+
+    // Largest value that lands in bucket b
+    static uint64_t bucketHigh(int b) {
+        if (b < SUB) return (uint64_t)b;
+        int shift = b / SUB - 1;
+        uint64_t sub = (uint64_t)(b % SUB);
+        return ((SUB + sub + 1) << shift) - 1;
+    }
+
+    void record(uint64_t ns) {
+        counts[bucketOf(ns)].fetch_add(1, memory_order_relaxed);
+        total.fetch_add(1, memory_order_relaxed);
+        sumNs.fetch_add(ns, memory_order_relaxed);
+        uint64_t prev = maxNs.load(memory_order_relaxed);
+        while (ns > prev && !maxNs.compare_exchange_weak(prev, ns, memory_order_relaxed)) {}
+    }
+
+    uint64_t percentile(double p) const {
+        uint64_t n = total.load(memory_order_relaxed);
+        if (n == 0) return 0;
+        uint64_t rank = (uint64_t)ceil(p / 100.0 * n), seen = 0;
+        if (rank == 0) rank = 1;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += counts[b].load(memory_order_relaxed);
+            if (seen >= rank) return min(bucketHigh(b), maxNs.load(memory_order_relaxed));
+        }
+        return maxNs.load(memory_order_relaxed);
+    }
+};
+
+LatencyHistogram metricHistograms[(int)Metric::COUNT];
+
+struct PosCounters {
+    atomic<uint64_t> transactions{ 0 };
+    atomic<uint64_t> refunds{ 0 };
+    atomic<uint64_t> itemsSold{ 0 };
+    atomic<uint64_t> bytesSaved{ 0 };    // by saveData
+    atomic<uint64_t> journalBytes{ 0 };
+    atomic<uint64_t> journalFlushes{ 0 }; // group commits, one fsync each
+    atomic<uint64_t> segmentsLoaded{ 0 }; // booking months loaded on demand
+};
+PosCounters counters;
+
+time_t lastMetricsDump = 0;
+
+// Times the enclosing scope into one histogram
+struct ScopedTimer {
+    Metric metric;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    explicit ScopedTimer(Metric m) : metric(m) {}
+    ~ScopedTimer() {
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        metricHistograms[(int)metric].record((uint64_t)max<int64_t>(0, ns));
+    }
+};
+
+void printMetrics(ostream& out) {
+    out << "transactions " << counters.transactions.load() << "\n";
+    out << "refunds " << counters.refunds.load() << "\n";
+    out << "items_sold " << counters.itemsSold.load() << "\n";
+    out << "bytes_saved " << counters.bytesSaved.load() << "\n";
+    out << "journal_bytes " << counters.journalBytes.load() << "\n";
+    out << "journal_flushes " << counters.journalFlushes.load() << "\n";
+    out << "segments_loaded " << counters.segmentsLoaded.load() << "\n";
+    out << "# op count mean_us p50_us p90_us p99_us max_us\n";
+    for (int i = 0; i < (int)Metric::COUNT; i++) {
+        const LatencyHistogram& h = metricHistograms[i];
+        uint64_t n = h.total.load();
+        out << METRIC_NAMES[i] << " " << n << fixed << setprecision(1)
+            << " " << (n ? h.sumNs.load() / 1000.0 / n : 0.0)
+            << " " << h.percentile(50) / 1000.0 << " " << h.percentile(90) / 1000.0
+            << " " << h.percentile(99) / 1000.0 << " " << h.maxNs.load() / 1000.0 << "\n";
+    }
+}
+
+void dumpMetrics() {
+    ofstream out(FILE_METRICS);
+    if (!out) return;
+    printMetrics(out);
+    lastMetricsDump = time(nullptr);
+}
+
+// Called from the main loop; rewrites the metrics file at most once a period
+void maybeDumpMetrics() {
+    if (time(nullptr) - lastMetricsDump >= METRICS_DUMP_EVERY_SECONDS) dumpMetrics();
+}
 
 // ================= UTIL HELPERS =================
 static inline void clearBadInput() {
@@ -143,431 +493,3049 @@ bool parseCourtBookingItem(const string& item, string& facility, string& date, i
     return true;
 }
 
-bool hasCourtClash(const string& facility, const string& date, int startHHMM, int endHHMM) {
-    int startMin = toMinutes(startHHMM);
-    int endMin = toMinutes(endHHMM);
+// ================= COURT SCHEDULE INDEX =================
+// Booked court intervals grouped by (facility, date), kept sorted by start time.
+// Built once in loadData and updated on checkout / refund / admin removal, so a
+// clash check never has to walk (or re-parse) the booking history.
+//
+// Each court-day also keeps an occupancy bitmap over operating hours, one bit
+// per 15 minutes (48 cells in one uint64_t). Free-slot queries are bit scans
+// on it, and a clash check on grid-aligned times is a single AND.
+const int OPEN_MINUTE = 10 * 60;
+const int CLOSE_MINUTE = 22 * 60;
+const int GRID_STEP = 15;
+const int GRID_CELLS = (CLOSE_MINUTE - OPEN_MINUTE) / GRID_STEP;
+const uint64_t GRID_FULL = (1ULL << GRID_CELLS) - 1;
+const int MIN_COURT_MINUTES = 60;
+static_assert(GRID_CELLS <= 64, "a court-day must fit in one word");
+
+struct CourtDaySchedule {
+    vector<pair<int, int>> slots; // [startMin, endMin), sorted by start
+    vector<int> maxEnd;           // maxEnd[i] = max end over slots[0..i]
+    uint64_t busy = 0;            // grid cells touched by any slot
+    bool aligned = true;          // every slot is on the grid, so busy is exact
+};
 
-    for (const auto& b : allBookings) {
-        for (const auto& it : b.items) {
-            string f, d;
-            int sHHMM, eHHMM;
-            if (!parseCourtBookingItem(it, f, d, sHHMM, eHHMM)) continue;
+struct FacilityDaySchedule {
+    vector<CourtDaySchedule> courts; // by court number
+};
 
-            if (f == facility && d == date) {
-                int sMin = toMinutes(sHHMM);
-                int eMin = toMinutes(eHHMM);
+map<pair<int, DayNum>, FacilityDaySchedule> courtSchedule; // (facility id, day) -> its courts
 
-                // overlap if NOT (new ends before old starts OR new starts after old ends)
-                if (!(endMin <= sMin || startMin >= eMin)) return true;
-            }
-        }
+constexpr bool onGrid(int minute) {
+    return minute >= OPEN_MINUTE && minute <= CLOSE_MINUTE && (minute - OPEN_MINUTE) % GRID_STEP == 0;
+}
+
+// Grid cells touched by [startMin, endMin); partly covered cells count
+constexpr uint64_t gridMask(int startMin, int endMin) {
+    int first = (max(startMin, OPEN_MINUTE) - OPEN_MINUTE) / GRID_STEP;
+    int last = (min(endMin, CLOSE_MINUTE) - OPEN_MINUTE + GRID_STEP - 1) / GRID_STEP;
+    return last <= first ? 0 : ((1ULL << (last - first)) - 1) << first;
+}
+
+static_assert(gridMask(10 * 60, 11 * 60) == 0xF, "first hour");
+static_assert(gridMask(21 * 60 + 50, 23 * 60) == 1ULL << (GRID_CELLS - 1), "clipped to closing");
+static_assert(gridMask(9 * 60, 10 * 60) == 0, "before opening");
+
+static inline int lowestSetBit(uint64_t v) { // v != 0
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return (int)i;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static inline int highestSetBit(uint64_t v) { // v != 0
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return (int)i;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+static void refreshDay(CourtDaySchedule& day) {
+    day.maxEnd.resize(day.slots.size());
+    day.busy = 0;
+    day.aligned = true;
+    int mx = 0;
+    for (size_t i = 0; i < day.slots.size(); ++i) {
+        const pair<int, int>& slot = day.slots[i];
+        mx = max(mx, slot.second);
+        day.maxEnd[i] = mx;
+        day.busy |= gridMask(slot.first, slot.second);
+        day.aligned = day.aligned && onGrid(slot.first) && onGrid(slot.second);
+    }
+}
+
+void indexCourtBooking(const BookingRecord& b) {
+    for (const auto& it : b.items) {
+        if (!it.isCourt()) continue;
+
+        FacilityDaySchedule& facilityDay = courtSchedule[{ it.refId, it.date }];
+        if ((int)facilityDay.courts.size() <= it.court) facilityDay.courts.resize(it.court + 1);
+        CourtDaySchedule& day = facilityDay.courts[it.court];
+        pair<int, int> slot(it.slotStart, it.slotEnd);
+        day.slots.insert(upper_bound(day.slots.begin(), day.slots.end(), slot), slot);
+        refreshDay(day);
+    }
+}
+
+void unindexCourtBooking(const BookingRecord& b) {
+    for (const auto& it : b.items) {
+        if (!it.isCourt()) continue;
+
+        auto dayIt = courtSchedule.find({ it.refId, it.date });
+        if (dayIt == courtSchedule.end() || it.court >= (int)dayIt->second.courts.size()) continue;
+
+        CourtDaySchedule& day = dayIt->second.courts[it.court];
+        pair<int, int> slot(it.slotStart, it.slotEnd);
+        auto pos = lower_bound(day.slots.begin(), day.slots.end(), slot);
+        if (pos == day.slots.end() || *pos != slot) continue;
+
+        day.slots.erase(pos);
+        refreshDay(day);
+
+        const vector<CourtDaySchedule>& courts = dayIt->second.courts;
+        if (all_of(courts.begin(), courts.end(), [](const CourtDaySchedule& c) { return c.slots.empty(); }))
+            courtSchedule.erase(dayIt);
+    }
+}
+
+void rebuildCourtSchedule() {
+    courtSchedule.clear();
+    for (const auto& b : allBookings) if (!b.cancelled) indexCourtBooking(b);
+}
+
+static const CourtDaySchedule* findCourtDay(int facilityId, int court, DayNum date) {
+    auto dayIt = courtSchedule.find({ facilityId, date });
+    if (dayIt == courtSchedule.end() || court < 0 || court >= (int)dayIt->second.courts.size()) return nullptr;
+    return &dayIt->second.courts[court];
+}
+
+static bool overlapsAny(const CourtDaySchedule& day, int startMin, int endMin) {
+    if (day.aligned && onGrid(startMin) && onGrid(endMin)) return (day.busy & gridMask(startMin, endMin)) != 0;
+
+    // Last slot that starts before the new one ends; overlap if any slot up to
+    // there is still running when the new one starts.
+    auto pos = lower_bound(day.slots.begin(), day.slots.end(), make_pair(endMin, INT_MIN));
+    if (pos == day.slots.begin()) return false;
+    size_t idx = (size_t)(pos - day.slots.begin()) - 1;
+    return day.maxEnd[idx] > startMin;
+}
+
+// facilityId indexes FACILITIES, court is 0-based, times in minutes
+bool hasCourtClash(int facilityId, int court, DayNum date, int startMin, int endMin) {
+    const CourtDaySchedule* day = findCourtDay(facilityId, court, date);
+    return day && overlapsAny(*day, startMin, endMin);
+}
+
+// Occupied grid cells of one court-day (0 = nothing booked)
+uint64_t courtBusyCells(int facilityId, int court, DayNum date) {
+    const CourtDaySchedule* day = findCourtDay(facilityId, court, date);
+    return day ? day->busy : 0;
+}
+
+// Court lines in [lines, lines + count) on this court-day: true if one
+// overlaps [startMin, endMin), else their cells are added to busy
+static bool linesClash(const LineItem* lines, size_t count, int facilityId, int court, DayNum date,
+    int startMin, int endMin, uint64_t& busy) {
+    for (size_t i = 0; i < count; i++) {
+        const LineItem& o = lines[i];
+        if (!o.isCourt() || o.refId != facilityId || o.court != court || o.date != date) continue;
+        if (o.slotStart < endMin && startMin < o.slotEnd) return true;
+        busy |= gridMask(o.slotStart, o.slotEnd);
     }
     return false;
 }
 
+// Best-fit court for [startMin, endMin), or -1 if every court is taken. Lines
+// in `pending` (e.g. the rest of a cart) count as booked. Among free courts it
+// takes the one whose leftover gap pieces waste the least time (a piece
+// shorter than MIN_COURT_MINUTES can never be sold), then the tightest gap,
+// then the lowest number. One word test per court. Caller holds storeMutex.
+int pickCourt(int facilityId, DayNum date, int startMin, int endMin, const LineItem* pending = nullptr, size_t pendingCount = 0) {
+    auto dayIt = courtSchedule.find({ facilityId, date });
+    const FacilityDaySchedule* facilityDay = dayIt == courtSchedule.end() ? nullptr : &dayIt->second;
+    uint64_t want = gridMask(startMin, endMin);
+    int firstCell = want ? lowestSetBit(want) : 0;
+    int lastCell = want ? highestSetBit(want) + 1 : 0;
+
+    int best = -1, bestWaste = 0, bestGap = 0;
+    for (int c = 0; c < FACILITIES[facilityId].courts; c++) {
+        const CourtDaySchedule* day = facilityDay && c < (int)facilityDay->courts.size() ? &facilityDay->courts[c] : nullptr;
+        if (day && overlapsAny(*day, startMin, endMin)) continue;
+        uint64_t busy = day ? day->busy : 0;
+        if (linesClash(pending, pendingCount, facilityId, c, date, startMin, endMin, busy)) continue;
+
+        // Free gap around the request: back to the previous busy cell, on to the next
+        uint64_t before = busy & ((1ULL << firstCell) - 1);
+        int gapStart = before ? highestSetBit(before) + 1 : 0;
+        int gapEnd = lastCell + lowestSetBit((busy | ~GRID_FULL) >> lastCell);
+        int left = (firstCell - gapStart) * GRID_STEP, right = (gapEnd - lastCell) * GRID_STEP;
+        int waste = (left < MIN_COURT_MINUTES ? left : 0) + (right < MIN_COURT_MINUTES ? right : 0);
+        int gap = left + right;
+        if (best < 0 || waste < bestWaste || (waste == bestWaste && gap < bestGap)) {
+            best = c;
+            bestWaste = waste;
+            bestGap = gap;
+        }
+    }
+    return best;
+}
+
+// Maximal free stretches in a busy mask that last at least minMinutes, as
+// [startMin, endMin) pairs in time order.
+vector<pair<int, int>> freeRuns(uint64_t busy, int minMinutes) {
+    vector<pair<int, int>> runs;
+    int minCells = max(1, (minMinutes + GRID_STEP - 1) / GRID_STEP);
+    uint64_t free = ~busy & GRID_FULL;
+    while (free) {
+        int first = lowestSetBit(free);
+        int len = lowestSetBit(~(free >> first)); // bits above the grid are 0, so this stops
+        if (len >= minCells)
+            runs.push_back({ OPEN_MINUTE + first * GRID_STEP, OPEN_MINUTE + (first + len) * GRID_STEP });
+        free &= ~(((1ULL << len) - 1) << first);
+    }
+    return runs;
+}
+
+struct CourtSlot {
+    int court;
+    int startMin, endMin;
+};
+
+// When no court is free for [startMin, endMin): up to maxCount slots of the
+// same length on any court of the facility, closest in start time first (one
+// court per start time). `blocked` marks cells that cannot be sold (already
+// started today). Caller holds storeMutex.
+vector<CourtSlot> nearestCourtSlots(int facilityId, DayNum date, int startMin, int endMin, uint64_t blocked,
+    size_t maxCount, const LineItem* pending = nullptr, size_t pendingCount = 0) {
+    int length = endMin - startMin;
+    vector<CourtSlot> found;
+    for (int c = 0; c < FACILITIES[facilityId].courts; c++) {
+        uint64_t busy = courtBusyCells(facilityId, c, date) | blocked;
+        linesClash(pending, pendingCount, facilityId, c, date, INT_MAX, INT_MIN, busy); // only collects cells
+        for (const auto& run : freeRuns(busy, length)) {
+            int start = min(max(startMin, run.first), run.second - length);
+            found.push_back({ c, start, start + length });
+        }
+    }
+
+    sort(found.begin(), found.end(), [&](const CourtSlot& a, const CourtSlot& b) {
+        int da = abs(a.startMin - startMin), db = abs(b.startMin - startMin);
+        if (da != db) return da < db;
+        return a.startMin != b.startMin ? a.startMin < b.startMin : a.court < b.court;
+    });
+    vector<CourtSlot> out;
+    for (const CourtSlot& s : found) {
+        if (out.size() >= maxCount) break;
+        bool sameTime = any_of(out.begin(), out.end(), [&](const CourtSlot& o) { return o.startMin == s.startMin; });
+        if (!sameTime) out.push_back(s);
+    }
+    return out;
+}
 
 static inline bool startsWith(const string& s, const string& prefix) {
     return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
 }
 
-void pause() {
+void pauseScreen() {
     cout << "\n----------------------------------------";
     cout << "\nPress Enter to return to Main Menu...";
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     cin.get();
 }
 
+// ================= ENTRY OCCUPANCY =================
+// Per-entry facilities are sold by session (two-hour blocks over operating
+// hours). People holding a pass are counted per (facility, day, session) and
+// kept current on checkout / refund / admin removal, so a capacity check is
+// one hash lookup. Passes from before sessions (no time) are not counted.
+const int ENTRY_SESSION_MINUTES = 120;
+const int ENTRY_SESSIONS = (CLOSE_MINUTE - OPEN_MINUTE) / ENTRY_SESSION_MINUTES;
+
+struct EntryDayCount {
+    int people[ENTRY_SESSIONS] = {};
+};
+
+unordered_map<uint64_t, EntryDayCount> entryOccupancy; // (day, facility id) -> people per session
+
+static inline uint64_t entryKey(int facilityId, DayNum date) {
+    return (uint64_t)(uint32_t)date << 8 | (uint32_t)facilityId;
+}
+
+// Session index of an entry line, or -1
+int entrySessionOf(const LineItem& it) {
+    if (it.kind != ItemKind::Booking || it.isCourt() || it.slotEnd <= it.slotStart) return -1;
+    int offset = it.slotStart - OPEN_MINUTE;
+    if (offset < 0 || offset % ENTRY_SESSION_MINUTES != 0 || offset / ENTRY_SESSION_MINUTES >= ENTRY_SESSIONS) return -1;
+    return offset / ENTRY_SESSION_MINUTES;
+}
+
+void countEntryBooking(const BookingRecord& b, int sign) {
+    for (const auto& it : b.items) {
+        int session = entrySessionOf(it);
+        if (session < 0) continue;
+        auto key = entryKey(it.refId, it.date);
+        EntryDayCount& day = entryOccupancy[key];
+        day.people[session] += sign * it.qty;
+        if (all_of(begin(day.people), end(day.people), [](int n) { return n <= 0; })) entryOccupancy.erase(key);
+    }
+}
+
+void rebuildEntryOccupancy() {
+    entryOccupancy.clear();
+    for (const auto& b : allBookings) if (!b.cancelled) countEntryBooking(b, +1);
+}
+
+int entryOccupancyOf(int facilityId, DayNum date, int session) {
+    auto it = entryOccupancy.find(entryKey(facilityId, date));
+    return it == entryOccupancy.end() ? 0 : it->second.people[session];
+}
+
 // ================= DATE / TIME HELPERS =================
-bool isLeapYear(int y) {
+// Dates are day numbers (1 = 01/01/1900, 0 = no date) and times of day are
+// minutes, so they compare, sort and hash as plain integers. The calendar
+// math is constexpr and parse/format work on fixed char buffers; strings are
+// only built for display and the text files.
+
+struct CivilDate {
+    int d, m, y;
+};
+
+constexpr bool isLeapYear(int y) {
     return ((y % 4 == 0 && y % 100 != 0) || (y % 400 == 0));
 }
 
-bool isValidDate(int day, int month, int year) {
-    if (year < 1900 || year > 2100) return false;
-    if (month < 1 || month > 12) return false;
-    if (day < 1) return false;
+constexpr int daysInMonth(int m, int y) {
+    return m == 2 ? (isLeapYear(y) ? 29 : 28) : (m == 4 || m == 6 || m == 9 || m == 11) ? 30 : 31;
+}
 
-    int daysInMonth[] = { 0,31,28,31,30,31,30,31,31,30,31,30,31 };
-    if (month == 2 && isLeapYear(year)) daysInMonth[2] = 29;
-    return day <= daysInMonth[month];
+constexpr bool isValidDate(int day, int month, int year) {
+    return year >= 1900 && year <= 2100 && month >= 1 && month <= 12 && day >= 1 && day <= daysInMonth(month, year);
 }
 
-bool parseDateDDMMYYYY(const string& s, int& d, int& m, int& y) {
-    if (s.size() != 10 || s[2] != '/' || s[5] != '/') return false;
-    try {
-        d = stoi(s.substr(0, 2));
-        m = stoi(s.substr(3, 2));
-        y = stoi(s.substr(6, 4));
-    }
-    catch (...) {
-        return false;
+// Days-from-civil over 400-year eras (exact for the proleptic Gregorian calendar)
+constexpr DayNum dayFromCivil(int d, int m, int y) {
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468 + 25568; // 1970-based -> 1900-based
+}
+
+constexpr CivilDate civilFromDay(DayNum day) {
+    int z = day - 25568 + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int d = doy - (153 * mp + 2) / 5 + 1;
+    int m = mp + (mp < 10 ? 3 : -9);
+    return { d, m, yoe + era * 400 + (m <= 2) };
+}
+
+// 0 = Sunday ... 6 = Saturday
+constexpr int weekdayOf(DayNum day) {
+    return day % 7;
+}
+
+constexpr bool isWeekend(DayNum day) {
+    return weekdayOf(day) == 0 || weekdayOf(day) == 6;
+}
+
+// Same day of month N months later, clamped to the month's last day (31/01 + 1 -> 28/02)
+constexpr DayNum addMonths(DayNum day, int months) {
+    CivilDate c = civilFromDay(day);
+    int idx = c.y * 12 + (c.m - 1) + months;
+    int y = idx / 12, m = idx % 12 + 1;
+    return dayFromCivil(min(c.d, daysInMonth(m, y)), m, y);
+}
+
+// Month as one integer (YYYY * 12 + MM - 1) for monthly keys
+constexpr int monthIndexOf(DayNum day) {
+    CivilDate c = civilFromDay(day);
+    return c.y * 12 + c.m - 1;
+}
+
+static_assert(dayFromCivil(1, 1, 1900) == 1, "day numbers start at 01/01/1900");
+static_assert(weekdayOf(dayFromCivil(17, 10, 2026)) == 6, "17/10/2026 is a Saturday");
+static_assert(civilFromDay(dayFromCivil(29, 2, 2024)).d == 29, "leap day round trip");
+static_assert(addMonths(dayFromCivil(31, 1, 2025), 1) == dayFromCivil(28, 2, 2025), "month end clamps");
+
+static inline bool readDigits(const char* s, int n, int& out) {
+    out = 0;
+    for (int i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        out = out * 10 + (s[i] - '0');
     }
-    return isValidDate(d, m, y);
+    return true;
 }
 
+static inline void writeDigits(char* s, int n, int value) {
+    for (int i = n - 1; i >= 0; i--) { s[i] = (char)('0' + value % 10); value /= 10; }
+}
 
-string getCurrentTimestamp(bool includeTime = false) {
-    time_t t = time(nullptr);
+// "DD/MM/YYYY"
+bool parseDate(const char* s, size_t n, DayNum& out) {
+    int d, m, y;
+    if (n != 10 || s[2] != '/' || s[5] != '/') return false;
+    if (!readDigits(s, 2, d) || !readDigits(s + 3, 2, m) || !readDigits(s + 6, 4, y)) return false;
+    if (!isValidDate(d, m, y)) return false;
+    out = dayFromCivil(d, m, y);
+    return true;
+}
+
+bool parseDate(const string& s, DayNum& out) {
+    return parseDate(s.data(), s.size(), out);
+}
+
+// "HH:MM" -> minutes of day
+bool parseTimeOfDay(const char* s, size_t n, int& minute) {
+    int hh, mm;
+    if (n != 5 || s[2] != ':' || !readDigits(s, 2, hh) || !readDigits(s + 3, 2, mm)) return false;
+    if (hh > 23 || mm > 59) return false;
+    minute = hh * 60 + mm;
+    return true;
+}
+
+// Writes "DD/MM/YYYY" plus a terminator into out[11]
+void formatDate(DayNum day, char* out) {
+    CivilDate c = civilFromDay(day);
+    writeDigits(out, 2, c.d);
+    out[2] = '/';
+    writeDigits(out + 3, 2, c.m);
+    out[5] = '/';
+    writeDigits(out + 6, 4, c.y);
+    out[10] = '\0';
+}
+
+string dateString(DayNum day) {
+    if (day == NO_DATE) return "-";
+    char buf[11];
+    formatDate(day, buf);
+    return string(buf, 10);
+}
+
+// "DD/MM/YYYY HH:MM", the sale time format of the booking file
+string stampString(DayNum day, int minute) {
+    if (day == NO_DATE) return "-";
+    char buf[17];
+    formatDate(day, buf);
+    buf[10] = ' ';
+    writeDigits(buf + 11, 2, minute / 60);
+    buf[13] = ':';
+    writeDigits(buf + 14, 2, minute % 60);
+    return string(buf, 16);
+}
+
+bool parseStamp(const string& s, DayNum& day, int& minute) {
+    minute = 0;
+    if (!parseDate(s.data(), min<size_t>(s.size(), 10), day)) return false;
+    return s.size() < 16 || parseTimeOfDay(s.data() + 11, 5, minute);
+}
+
+// "YYYY-MM"
+string monthString(int monthIndex) {
+    char buf[8];
+    writeDigits(buf, 4, monthIndex / 12);
+    buf[4] = '-';
+    writeDigits(buf + 5, 2, monthIndex % 12 + 1);
+    return string(buf, 7);
+}
+
+bool parseMonth(const string& s, int& monthIndex) {
+    int y, m;
+    if (s.size() != 7 || s[4] != '-' || !readDigits(s.data(), 4, y) || !readDigits(s.data() + 5, 2, m)) return false;
+    if (m < 1 || m > 12) return false;
+    monthIndex = y * 12 + m - 1;
+    return true;
+}
+
+// Packed YYYYMMDD, the date form of the item lines in bookings.txt
+constexpr int packedFromDay(DayNum day) {
+    return day == NO_DATE ? 0 : civilFromDay(day).y * 10000 + civilFromDay(day).m * 100 + civilFromDay(day).d;
+}
+
+constexpr DayNum dayFromPacked(int packed) {
+    return isValidDate(packed % 100, packed / 100 % 100, packed / 10000)
+        ? dayFromCivil(packed % 100, packed / 100 % 100, packed / 10000) : NO_DATE;
+}
+
+// Source of "now" for everything time-dependent; headless replay swaps in a scripted clock
+time_t systemClock() {
+    return time(nullptr);
+}
+
+time_t (*posClock)() = systemClock;
+
+void nowDayMinute(DayNum& day, int& minute) {
+    time_t t = posClock();
     tm now{};
 #ifdef _WIN32
     localtime_s(&now, &t);
 #else
     localtime_r(&t, &now);
 #endif
-    char buffer[32];
-    if (includeTime)
-        strftime(buffer, sizeof(buffer), "%d/%m/%Y %H:%M", &now);
-    else
-        strftime(buffer, sizeof(buffer), "%d/%m/%Y", &now);
+    day = dayFromCivil(now.tm_mday, now.tm_mon + 1, now.tm_year + 1900);
+    minute = now.tm_hour * 60 + now.tm_min;
+}
 
-    return string(buffer);
+DayNum today() {
+    DayNum day;
+    int minute;
+    nowDayMinute(day, minute);
+    return day;
 }
 
-string calculateExpiry(const string& joinDate, int durationMonths) {
-    int d, m, y;
-    if (!parseDateDDMMYYYY(joinDate, d, m, y)) return "Invalid Date";
+string getCurrentTimestamp(bool includeTime = false) {
+    DayNum day;
+    int minute;
+    nowDayMinute(day, minute);
+    return includeTime ? stampString(day, minute) : dateString(day);
+}
 
-    m += durationMonths;
-    while (m > 12) { m -= 12; y++; }
+// ================= MONEY =================
+// All amounts are Cents (sen) in an int64_t, so bills and report sums are exact
+// integer additions. Percentages (promo, member discount, SST) round half away
+// from zero to the nearest sen; text files carry exactly two decimals.
 
-    string dd = (d < 10 ? "0" : "") + to_string(d);
-    string mm = (m < 10 ? "0" : "") + to_string(m);
-    return dd + "/" + mm + "/" + to_string(y);
+constexpr Cents percentOf(Cents amount, int percent) {
+    Cents scaled = amount * percent;
+    return scaled >= 0 ? (scaled + 50) / 100 : -((-scaled + 50) / 100);
 }
 
-static inline string formatDDMMYYYY(int d, int m, int y) {
-    string dd = (d < 10 ? "0" : "") + to_string(d);
-    string mm = (m < 10 ? "0" : "") + to_string(m);
-    return dd + "/" + mm + "/" + to_string(y);
+static_assert(percentOf(1234, 10) == 123 && percentOf(1235, 10) == 124, "half rounds up");
+static_assert(percentOf(-1235, 10) == -124, "and away from zero when negative");
+static_assert(percentOf(10650, 6) == 639, "SST on RM 106.50");
+
+// "-12.34" into buf (at least 24 chars); returns the length
+int formatMoney(Cents c, char* buf) {
+    char tmp[24];
+    int n = 0;
+    bool neg = c < 0;
+    uint64_t v = neg ? 0 - (uint64_t)c : (uint64_t)c;
+    tmp[n++] = (char)('0' + v % 10); v /= 10;
+    tmp[n++] = (char)('0' + v % 10); v /= 10;
+    tmp[n++] = '.';
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    if (neg) tmp[n++] = '-';
+    for (int i = 0; i < n; i++) buf[i] = tmp[n - 1 - i];
+    return n;
 }
 
-// ================= CART HELPERS =================
-void addToCart(const string& itemName, double price, bool silent = false) {
-    currentCartItems.push_back(itemName);
-    currentCartTotal += price;
-    if (!silent) {
-        cout << ">> Added " << itemName << " (RM " << fixed << setprecision(2) << price << ") to bill.\n";
+string moneyString(Cents c) {
+    char buf[24];
+    return string(buf, formatMoney(c, buf));
+}
+
+// "12", "12.5" or "12.345" (rounded to the sen). Anything else strtod accepts
+// is read too: older files used the stream's default precision, e.g. "1.2e+06".
+bool parseMoney(const char* s, size_t n, Cents& out) {
+    size_t i = 0;
+    bool neg = false;
+    if (i < n && (s[i] == '-' || s[i] == '+')) neg = s[i++] == '-';
+
+    Cents whole = 0, frac = 0;
+    int wholeDigits = 0, fracDigits = 0;
+    bool roundUp = false;
+    while (i < n && isdigit((unsigned char)s[i]) && wholeDigits < 15) {
+        whole = whole * 10 + (s[i++] - '0');
+        wholeDigits++;
+    }
+    if (i < n && s[i] == '.') {
+        i++;
+        while (i < n && isdigit((unsigned char)s[i])) {
+            int d = s[i++] - '0';
+            if (fracDigits < 2) frac = frac * 10 + d;
+            else if (fracDigits == 2) roundUp = d >= 5;
+            fracDigits++;
+        }
+    }
+
+    if (i != n || wholeDigits + fracDigits == 0) {
+        string text(s, n);
+        char* end = nullptr;
+        double v = strtod(text.c_str(), &end);
+        if (text.empty() || *end != '\0' || !std::isfinite(v) || fabs(v) > 9e15) return false;
+        out = llround(v * 100.0);
+        return true;
     }
+
+    if (fracDigits == 0) frac = 0;
+    else if (fracDigits == 1) frac *= 10;
+    Cents c = whole * 100 + frac + (roundUp ? 1 : 0);
+    out = neg ? -c : c;
+    return true;
 }
 
-void clearCart() {
-    currentCartItems.clear();
-    currentCartTotal = 0.0;
-    cout << "Cart cleared.\n";
+bool parseMoney(const string& s, Cents& out) {
+    return parseMoney(s.data(), s.size(), out);
 }
 
-// ================= PROMO =================
-double getPromoDiscount(double subtotal) {
-    char hasCode;
-    do {
-        cout << "\nDo you have a promo code? (Y/N): ";
-        cin >> hasCode;
-        if (hasCode != 'Y' && hasCode != 'y' && hasCode != 'N' && hasCode != 'n')
-            cout << "Invalid input! Please enter Y or N.\n";
-    } while (hasCode != 'Y' && hasCode != 'y' && hasCode != 'N' && hasCode != 'n');
+// Reads one whitespace-separated amount; sets failbit if it is not one
+bool readMoney(istream& in, Cents& out) {
+    string text;
+    if (!(in >> text)) return false;
+    if (!parseMoney(text, out)) {
+        in.setstate(ios::failbit);
+        return false;
+    }
+    return true;
+}
+
+
+// ================= PRODUCT CATALOG =================
+// Dense id -> inventory slot table plus a name -> id map, so sales, restock
+// and refunds find a product in constant time. Rebuilt whenever inventory is
+// replaced wholesale; addProduct keeps it current for single additions.
+const int MAX_PRODUCT_ID = 999999;
+
+vector<int> productSlotById;                 // -1 = no product with that id
+unordered_map<string, int> productIdByName;
+
+static void indexProduct(int slot) {
+    const Product& p = inventory[slot];
+    if (p.id >= 0 && p.id <= MAX_PRODUCT_ID) {
+        if ((size_t)p.id >= productSlotById.size()) productSlotById.resize((size_t)p.id + 1, -1);
+        productSlotById[p.id] = slot;
+    }
+    productIdByName.emplace(p.name, p.id);
+}
+
+void rebuildProductCatalog() {
+    productSlotById.assign(productSlotById.size(), -1);
+    productIdByName.clear();
+    for (size_t i = 0; i < inventory.size(); i++) indexProduct((int)i);
+}
+
+Product* findProduct(int id) {
+    if (id >= 0 && id <= MAX_PRODUCT_ID) {
+        if ((size_t)id >= productSlotById.size() || productSlotById[id] < 0) return nullptr;
+        return &inventory[productSlotById[id]];
+    }
+    // ids outside the table range can only come from hand-edited files
+    auto it = find_if(inventory.begin(), inventory.end(), [&](const Product& p) { return p.id == id; });
+    return it == inventory.end() ? nullptr : &*it;
+}
+
+Product* findProductByName(const string& name) {
+    auto it = productIdByName.find(name);
+    return it == productIdByName.end() ? nullptr : findProduct(it->second);
+}
+
+// Returns false if the id is taken
+bool addProduct(const Product& p) {
+    if (findProduct(p.id)) return false;
+    inventory.push_back(p);
+    indexProduct((int)inventory.size() - 1);
+    return true;
+}
+
+// ================= LINE ITEMS =================
+
+// Court rate is per hour; bookings may run in partial hours (90 mins = 1.5h)
+Cents courtPriceCents(int facilityId, bool weekend, int minutes) {
+    const FacilityDef& f = FACILITIES[facilityId];
+    Cents rate = weekend ? f.weekendCents : f.weekdayCents;
+    return (rate * minutes + 30) / 60;
+}
+
+Cents entryPriceCents(int facilityId, bool weekend) {
+    const FacilityDef& f = FACILITIES[facilityId];
+    return weekend ? f.weekendCents : f.weekdayCents;
+}
+
+// Item name without its category prefix, e.g. "Gatorade"
+string itemName(const LineItem& it) {
+    switch (it.kind) {
+    case ItemKind::Booking:
+        if (it.refId >= 0 && it.refId < FACILITY_COUNT) return FACILITIES[it.refId].name;
+        break;
+    case ItemKind::Rental:
+        if (it.refId >= 0 && it.refId < RENTAL_COUNT) return RENTALS[it.refId].name;
+        break;
+    case ItemKind::Locker:
+        if (it.refId >= 0 && it.refId < LOCKER_COUNT) return LOCKERS[it.refId].name;
+        break;
+    case ItemKind::Product:
+        if (const Product* p = findProduct(it.refId)) return p->name;
+        return "Product #" + to_string(it.refId);
+    case ItemKind::Other:
+        if (it.refId >= 0 && it.refId < (int)otherItemNames.size()) return otherItemNames[it.refId];
+        break;
+    }
+    return "Unknown";
+}
+
+static inline string slotHHMM(int minutes) {
+    return to_string(minutes / 60 * 100 + minutes % 60);
+}
+
+// Display text, same shape as the old free-text items
+string itemLabel(const LineItem& it) {
+    string label;
+    switch (it.kind) {
+    case ItemKind::Booking:
+        label = "Booking: " + itemName(it);
+        if (it.isCourt()) label += " " + to_string(it.court + 1);
+        label += " [" + dateString(it.date);
+        if (it.isCourt()) label += " " + slotHHMM(it.slotStart) + "-" + slotHHMM(it.slotEnd);
+        label += "]";
+        break;
+    case ItemKind::Rental:  label = "Rent: " + itemName(it); break;
+    case ItemKind::Locker:  label = "Locker: " + itemName(it); break;
+    case ItemKind::Product: return "Buy: " + itemName(it) + " x " + to_string(it.qty);
+    case ItemKind::Other:   label = itemName(it); break;
+    }
+    if (it.qty > 1) label += " x " + to_string(it.qty);
+    return label;
+}
+
+// Same thing at the same price (quantity aside)?
+static inline bool sameLine(const LineItem& a, const LineItem& b) {
+    return a.kind == b.kind && a.refId == b.refId && a.unitCents == b.unitCents
+        && a.date == b.date && a.slotStart == b.slotStart && a.slotEnd == b.slotEnd;
+}
+
+// Append a line, folding it into an identical non-court line if there is one
+void appendLine(vector<LineItem>& lines, const LineItem& item) {
+    if (!item.isCourt()) {
+        for (auto& l : lines) {
+            if (sameLine(l, item)) { l.qty += item.qty; return; }
+        }
+    }
+    lines.push_back(item);
+}
+
+static int internOtherName(const string& text) {
+    static unordered_map<string, int> ids;
+    auto it = ids.find(text);
+    if (it != ids.end()) return it->second;
+    otherItemNames.push_back(text);
+    ids.emplace(text, (int)otherItemNames.size() - 1);
+    return (int)otherItemNames.size() - 1;
+}
+
+// Map an old free-text item ("Buy: Gatorade x 3", "Booking: Badminton Court
+// [16/12/2025 1330-1430]", ...) onto a typed line. Prices are re-derived from
+// the catalog since the old format never stored them.
+LineItem upgradeLegacyItem(const string& text) {
+    LineItem it;
+    auto otherLine = [&]() {
+        LineItem o;
+        o.kind = ItemKind::Other;
+        o.refId = internOtherName(trimCopy(text));
+        return o;
+    };
+
+    if (startsWith(text, "Booking:")) {
+        size_t lb = text.find('['), rb = text.find(']');
+        if (lb == string::npos || rb == string::npos || rb <= lb) return otherLine();
+        string name = trimCopy(text.substr(8, lb - 8));
+        string inside = trimCopy(text.substr(lb + 1, rb - lb - 1));
+
+        it.kind = ItemKind::Booking;
+        it.refId = -1;
+        for (int i = 0; i < FACILITY_COUNT; i++) if (name == FACILITIES[i].name) it.refId = i;
+        if (it.refId < 0 || !parseDate(inside.data(), min<size_t>(inside.size(), 10), it.date)) return otherLine();
+
+        bool weekend = isWeekend(it.date);
+        if (FACILITIES[it.refId].hourly) {
+            string f, d;
+            int sHHMM, eHHMM;
+            if (!parseCourtBookingItem(text, f, d, sHHMM, eHHMM)) return otherLine();
+            it.slotStart = (int16_t)toMinutes(sHHMM);
+            it.slotEnd = (int16_t)toMinutes(eHHMM);
+            it.unitCents = courtPriceCents(it.refId, weekend, it.slotEnd - it.slotStart);
+        }
+        else {
+            it.unitCents = entryPriceCents(it.refId, weekend);
+        }
+        return it;
+    }
+
+    if (startsWith(text, "Rent:")) {
+        string name = trimCopy(text.substr(5));
+        for (int i = 0; i < RENTAL_COUNT; i++) {
+            if (name == RENTALS[i].name) {
+                it.kind = ItemKind::Rental; it.refId = i; it.unitCents = RENTALS[i].priceCents;
+                return it;
+            }
+        }
+        return otherLine();
+    }
+
+    if (startsWith(text, "Locker:")) {
+        string name = trimCopy(text.substr(7));
+        for (int i = 0; i < LOCKER_COUNT; i++) {
+            if (name == LOCKERS[i].name) {
+                it.kind = ItemKind::Locker; it.refId = i; it.unitCents = LOCKERS[i].priceCents;
+                return it;
+            }
+        }
+        return otherLine();
+    }
+
+    if (startsWith(text, "Buy:")) {
+        string rest = trimCopy(text.substr(4));
+        size_t pos = rest.find(" x ");
+        if (pos == string::npos) return otherLine();
+        string name = trimCopy(rest.substr(0, pos));
+        try { it.qty = stoi(trimCopy(rest.substr(pos + 3))); }
+        catch (...) { return otherLine(); }
+
+        const Product* p = findProductByName(name);
+        if (!p) return otherLine();
+        it.kind = ItemKind::Product; it.refId = p->id; it.unitCents = p->priceCents;
+        return it;
+    }
+
+    return otherLine();
+}
+
+// Text form of a line: "<kind> refId qty unitCents YYYYMMDD slotStart slotEnd",
+// plus " court" on court bookings (missing = court 0), or "O qty unitCents
+// <text>" for unmapped legacy items.
+static const char ITEM_KIND_CODES[] = { 'B', 'R', 'L', 'P', 'O' };
+
+void writeLineItem(ostream& out, const LineItem& it) {
+    if (it.kind == ItemKind::Other) {
+        out << "O " << it.qty << " " << it.unitCents << " " << itemName(it);
+        return;
+    }
+    out << ITEM_KIND_CODES[(int)it.kind] << " " << it.refId << " " << it.qty << " " << it.unitCents
+        << " " << packedFromDay(it.date) << " " << it.slotStart << " " << it.slotEnd;
+    if (it.isCourt()) out << " " << it.court;
+}
+
+LineItem readLineItem(const string& line) {
+    // Typed lines start with a one-letter kind code; old free-text items with a word
+    bool typed = line.size() >= 2 && line[1] == ' '
+        && find(begin(ITEM_KIND_CODES), end(ITEM_KIND_CODES), line[0]) != end(ITEM_KIND_CODES);
+    if (!typed) return upgradeLegacyItem(line);
+
+    istringstream in(line);
+    LineItem it;
+    char code = 0;
+    in >> code;
+    if (code == 'O') {
+        in >> it.qty >> it.unitCents;
+        in.ignore();
+        string text;
+        getline(in, text);
+        it.kind = ItemKind::Other;
+        it.refId = internOtherName(text);
+        return it;
+    }
+
+    const char* k = find(begin(ITEM_KIND_CODES), end(ITEM_KIND_CODES), code);
+    int packed = 0, slotStart = 0, slotEnd = 0;
+    if (k == end(ITEM_KIND_CODES) || !(in >> it.refId >> it.qty >> it.unitCents >> packed >> slotStart >> slotEnd))
+        return upgradeLegacyItem(line);
+    it.kind = (ItemKind)(k - ITEM_KIND_CODES);
+    it.date = dayFromPacked(packed);
+    it.slotStart = (int16_t)slotStart;
+    it.slotEnd = (int16_t)slotEnd;
+    int court = 0;
+    if (it.isCourt() && in >> court && court >= 0 && court < MAX_COURTS) it.court = (int16_t)court;
+    return it;
+}
+
+// ================= CART HELPERS =================
+void addToCart(const LineItem& item, bool silent = false) {
+    appendLine(currentSession->cartItems, item);
+    currentSession->cartCents += item.lineCents();
+    if (!silent) cout << ">> Added " << itemLabel(item) << " (RM " << moneyString(item.lineCents()) << ") to bill.\n";
+}
+
+void clearCart() {
+    currentSession->cartItems.clear();
+    currentSession->cartCents = 0;
+    cout << "Cart cleared.\n";
+}
+
+// ================= PROMO =================
+// Discount for a promo code, or -1 if the code is unknown
+Cents promoDiscountFor(const string& code, Cents subtotal) {
+    // Support both versions + extra
+    if (code == "PROMO10") return percentOf(subtotal, 10);
+    if (code == "DISC5" || code == "SPORT2025") return 500;
+    return -1;
+}
+
+Cents getPromoDiscount(Cents subtotal) {
+    char hasCode;
+    do {
+        cout << "\nDo you have a promo code? (Y/N): ";
+        cin >> hasCode;
+        if (hasCode != 'Y' && hasCode != 'y' && hasCode != 'N' && hasCode != 'n')
+            cout << "Invalid input! Please enter Y or N.\n";
+    } while (hasCode != 'Y' && hasCode != 'y' && hasCode != 'N' && hasCode != 'n');
+
+    if (hasCode == 'N' || hasCode == 'n') return 0;
+
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    while (true) {
+        string code;
+        cout << "Enter promo code (or type EXIT to skip): ";
+        getline(cin, code);
+        code = trimCopy(code);
+
+        if (code == "EXIT") return 0;
+
+        Cents discount = promoDiscountFor(code, subtotal);
+        if (discount >= 0) {
+            if (code == "PROMO10") cout << ">> Promo applied: 10% OFF\n";
+            else cout << ">> Promo applied: RM 5 OFF\n";
+            return discount;
+        }
+
+        cout << "ERROR! Invalid promo code.\n";
+    }
+}
+
+// ================= MEMBER INDEX =================
+// Open-addressing (linear probing) hash table from phone number to slot in
+// `members`. Phone is the member's ID, so it is unique: registration rejects
+// duplicates and removal swaps the last member into the freed slot.
+class PhoneIndex {
+public:
+    int find(const string& phone) const {
+        if (table.empty()) return -1;
+        uint32_t h = hashPhone(phone);
+        for (size_t i = h & mask();; i = (i + 1) & mask()) {
+            const Entry& e = table[i];
+            if (e.slot < 0) return -1;
+            if (e.hash == h && members[e.slot].phone == phone) return e.slot;
+        }
+    }
+
+    void insert(const string& phone, int slot) {
+        if ((used + 1) * 2 > table.size()) grow();
+        uint32_t h = hashPhone(phone);
+        size_t i = h & mask();
+        while (table[i].slot >= 0) i = (i + 1) & mask();
+        table[i] = { h, slot };
+        used++;
+    }
+
+    // Point an existing phone at a new slot (after a swap-remove)
+    void move(const string& phone, int slot) {
+        size_t i = locate(phone);
+        if (i != NPOS) table[i].slot = slot;
+    }
+
+    void erase(const string& phone) {
+        size_t i = locate(phone);
+        if (i == NPOS) return;
+
+        // Backward-shift deletion keeps probe chains intact without tombstones
+        table[i].slot = -1;
+        used--;
+        for (size_t j = (i + 1) & mask(); table[j].slot >= 0; j = (j + 1) & mask()) {
+            size_t home = table[j].hash & mask();
+            bool movable = (j > i) ? (home <= i || home > j) : (home <= i && home > j);
+            if (movable) {
+                table[i] = table[j];
+                table[j].slot = -1;
+                i = j;
+            }
+        }
+    }
+
+    void clear() {
+        table.assign(16, Entry());
+        used = 0;
+    }
+
+private:
+    struct Entry {
+        uint32_t hash = 0;
+        int32_t slot = -1; // -1 = empty
+    };
+    static const size_t NPOS = (size_t)-1;
+
+    vector<Entry> table;
+    size_t used = 0;
+
+    size_t mask() const { return table.size() - 1; }
+
+    static uint32_t hashPhone(const string& s) {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (unsigned char c : s) { h ^= c; h *= 16777619u; }
+        return h;
+    }
+
+    size_t locate(const string& phone) const {
+        if (table.empty()) return NPOS;
+        uint32_t h = hashPhone(phone);
+        for (size_t i = h & mask();; i = (i + 1) & mask()) {
+            if (table[i].slot < 0) return NPOS;
+            if (table[i].hash == h && members[table[i].slot].phone == phone) return i;
+        }
+    }
+
+    void grow() {
+        vector<Entry> old = table.empty() ? vector<Entry>() : std::move(table);
+        table.assign(max<size_t>(16, old.size() * 2), Entry());
+        for (const Entry& e : old) {
+            if (e.slot < 0) continue;
+            size_t i = e.hash & mask();
+            while (table[i].slot >= 0) i = (i + 1) & mask();
+            table[i] = e;
+        }
+    }
+};
+
+PhoneIndex memberIndex;
+
+// Slot of the member with this phone, or -1
+int findMemberSlot(const string& phone) {
+    return memberIndex.find(phone);
+}
+
+// Returns false if the phone is already registered
+bool addMember(const Member& m) {
+    if (findMemberSlot(m.phone) >= 0) return false;
+    members.push_back(m);
+    memberIndex.insert(m.phone, (int)members.size() - 1);
+    return true;
+}
+
+// Insert or replace by phone (used when loading / replaying)
+void upsertMember(const Member& m) {
+    int slot = findMemberSlot(m.phone);
+    if (slot >= 0) members[slot] = m;
+    else addMember(m);
+}
+
+bool removeMember(const string& phone) {
+    int slot = findMemberSlot(phone);
+    if (slot < 0) return false;
+
+    memberIndex.erase(phone);
+    int last = (int)members.size() - 1;
+    if (slot != last) {
+        memberIndex.move(members[last].phone, slot); // re-point before the record moves
+        members[slot] = std::move(members[last]);
+    }
+    members.pop_back();
+    return true;
+}
+
+// Rebuild from `members`; a later record for the same phone replaces the earlier one
+void rebuildMemberIndex() {
+    vector<Member> loaded;
+    loaded.swap(members);
+    memberIndex.clear();
+    for (const auto& m : loaded) upsertMember(m);
+}
+
+// ================= DURABLE FILES =================
+// A save must never leave a half-written data file behind. writeFileAtomic
+// streams the new content into "<path>.tmp", fsyncs it, renames it over the
+// old file (atomic on POSIX and NTFS) and fsyncs the directory, so after a
+// crash or power cut either the old or the new file is there, complete.
+
+// Flush a closed file's data to disk
+static bool syncFile(const string& path) {
+#ifdef _WIN32
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    bool ok = FlushFileBuffers(h) != 0;
+    CloseHandle(h);
+    return ok;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+// Make a rename or removal in path's directory durable (no-op on Windows,
+// where MOVEFILE_WRITE_THROUGH covers it)
+static void syncDirOf(const string& path) {
+#ifndef _WIN32
+    string dir = std::filesystem::path(path).parent_path().string();
+    int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+#else
+    (void)path;
+#endif
+}
+
+static bool replaceFile(const string& from, const string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// fill(ostream&) writes the content. Returns the bytes written, or -1 with
+// the old file untouched.
+template <typename Fill>
+int64_t writeFileAtomic(const string& path, Fill fill, ios::openmode mode = ios::out) {
+    string tmp = path + ".tmp";
+    int64_t bytes = -1;
+    {
+        ofstream out(tmp, mode | ios::trunc);
+        if (out) {
+            fill(out);
+            out.flush();
+            if (out) bytes = (int64_t)out.tellp();
+        }
+    }
+    if (bytes < 0 || !syncFile(tmp) || !replaceFile(tmp, path)) {
+        remove(tmp.c_str());
+        return -1;
+    }
+    syncDirOf(path);
+    return bytes;
+}
+
+// ================= FILE HANDLING =================
+void loadDefaultsInventory() {
+    inventory.clear();
+    // Sports Products
+    inventory.push_back({ 201, "Badminton Racket", 10000, 10 });
+    inventory.push_back({ 202, "Badminton Strings", 2000, 20 });
+    inventory.push_back({ 203, "Shuttlecocks (12)", 7000, 30 });
+    inventory.push_back({ 204, "Paddle", 10000, 10 });
+    inventory.push_back({ 205, "Pickle Ball (6)", 5000, 20 });
+    inventory.push_back({ 206, "Basketball", 10000, 10 });
+    inventory.push_back({ 207, "Goggles", 2000, 15 });
+    inventory.push_back({ 208, "Swim Cap", 500, 20 });
+    // Drinks & Snacks
+    inventory.push_back({ 301, "Mineral Water", 250, 99 });
+    inventory.push_back({ 302, "100 Plus / Coca-Cola", 400, 50 });
+    inventory.push_back({ 303, "Gatorade", 400, 40 });
+    inventory.push_back({ 304, "Jasmine / Lemon Tea", 350, 40 });
+    inventory.push_back({ 305, "Redbull", 500, 30 });
+    inventory.push_back({ 306, "Milo", 350, 40 });
+    inventory.push_back({ 307, "Protein Shake", 1000, 20 });
+    inventory.push_back({ 308, "Biscuit", 500, 30 });
+    inventory.push_back({ 309, "Chocolate / Energy Bar", 350, 50 });
+    rebuildProductCatalog();
+}
+
+// Record readers/writers shared by the data files and the journal.
+bool readMember(istream& in, Member& m) {
+    if (!getline(in, m.name)) return false;
+    getline(in, m.phone);
+    getline(in, m.type);
+    string join, expiry;
+    getline(in, join);
+    bool ok = (bool)getline(in, expiry);
+    if (!parseDate(trimCopy(join), m.joinDate)) m.joinDate = NO_DATE;
+    if (!parseDate(trimCopy(expiry), m.expiryDate)) m.expiryDate = NO_DATE;
+    return ok;
+}
+
+void writeMember(ostream& out, const Member& m) {
+    out << m.name << "\n" << m.phone << "\n" << m.type << "\n"
+        << dateString(m.joinDate) << "\n" << dateString(m.expiryDate) << "\n";
+}
+
+bool readProduct(istream& in, Product& p) {
+    if (!(in >> p.id)) return false;
+    in.ignore();
+    getline(in, p.name);
+    readMoney(in, p.priceCents);
+    in >> p.stock;
+    in.ignore(numeric_limits<streamsize>::max(), '\n');
+    return (bool)in;
+}
+
+void writeProduct(ostream& out, const Product& p) {
+    out << p.id << "\n" << p.name << "\n" << moneyString(p.priceCents) << "\n" << p.stock << "\n";
+}
+
+bool readBookingRecord(istream& in, BookingRecord& b) {
+    int itemCount = 0;
+    if (!(in >> b.bookingID)) return false;
+    in.ignore();
+    string name, phone;
+    getline(in, name);
+    getline(in, phone);
+    b.customerName = customerStrings.intern(name);
+    b.customerPhone = customerStrings.intern(phone);
+    string stamp;
+    getline(in, stamp);
+    int minute = 0;
+    if (!parseStamp(trimCopy(stamp), b.day, minute)) b.day = NO_DATE;
+    b.minute = (int16_t)minute;
+    readMoney(in, b.totalCents);
+    in >> itemCount;
+    in.ignore();
+
+    b.items.clear();
+    for (int i = 0; i < itemCount && in; i++) { // a torn record may end anywhere
+        string itemLine;
+        getline(in, itemLine);
+        appendLine(b.items, readLineItem(itemLine));
+    }
+    return (bool)in;
+}
+
+void writeBookingRecord(ostream& out, const BookingRecord& b) {
+    out << b.bookingID << "\n";
+    out << customerText(b.customerName) << "\n";
+    out << customerText(b.customerPhone) << "\n";
+    out << stampString(b.day, b.minute) << "\n";
+    out << moneyString(b.totalCents) << "\n";
+    out << b.items.size() << "\n";
+    for (const auto& it : b.items) {
+        writeLineItem(out, it);
+        out << "\n";
+    }
+}
+
+// ================= BINARY SNAPSHOT =================
+// Optional binary copy of the loaded data, written at every checkpoint next to
+// the text files and memory-mapped by loadData, so startup does not have to
+// parse the recent history with streams. Bookings are those of the hot month
+// segments only (see BOOKING SEGMENTS), listed in a month table; older months
+// stay in their segment files. Layout: header, then fixed-width member /
+// product / booking / item / feedback records, the month table, then one pool
+// holding every string (deduplicated). The text files stay the import/export
+// format: the snapshot is skipped if it is missing, invalid, or older than any
+// text file.
+bool snapshotEnabled = true;
+
+const char SNAPSHOT_MAGIC[8] = { 'R', 'S', 'W', 'S', 'N', 'A', 'P', 0 };
+const uint32_t SNAPSHOT_VERSION = 5;
+
+struct SnapStr { uint32_t off, len; }; // slice of the string pool
+
+struct SnapHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t memberCount;
+    uint32_t productCount;
+    uint32_t bookingCount;
+    uint32_t itemCount;
+    uint32_t feedbackCount;
+    int32_t nextBookingID;
+    uint32_t otherNameCount;
+    uint32_t segmentCount; // hot months whose bookings are included
+    uint32_t reserved;
+    uint64_t poolSize;
+};
+
+struct SnapMember {
+    SnapStr name, phone, type;
+    int32_t joinDate, expiryDate;
+};
+
+struct SnapProduct {
+    int32_t id;
+    int32_t stock;
+    int64_t priceCents;
+    SnapStr name;
+};
+
+struct SnapBooking {
+    int32_t bookingID;
+    uint32_t firstItem; // index into the item table
+    uint32_t itemCount;
+    uint32_t reserved;
+    int64_t totalCents;
+    SnapStr customerName, customerPhone;
+    int32_t day;
+    int16_t minute;
+    int16_t reserved2;
+};
+
+struct SnapItem {
+    uint8_t kind;
+    uint8_t court;
+    int16_t slotStart;
+    int16_t slotEnd;
+    int16_t reserved2;
+    int32_t refId; // Other: index into the snapshot's own name table
+    int32_t qty;
+    int32_t date;
+    int32_t reserved3;
+    int64_t unitCents;
+};
+
+class SnapPoolWriter {
+public:
+    SnapStr add(string_view s) {
+        auto it = seen.find(s);
+        if (it != seen.end()) return { it->second, (uint32_t)s.size() };
+        uint32_t off = (uint32_t)pool.size();
+        pool.append(s.data(), s.size());
+        seen.emplace(s, off);
+        return { off, (uint32_t)s.size() };
+    }
+    const string& data() const { return pool; }
+
+private:
+    string pool;
+    unordered_map<string_view, uint32_t> seen; // views the caller's strings
+};
+
+template <typename T>
+static void writeRaw(ostream& out, const T& v) { out.write((const char*)&v, sizeof(T)); }
+
+vector<int> hotSegmentMonths();
+
+void writeSnapshot() {
+    ScopedTimer timer(Metric::Snapshot);
+    if (!snapshotEnabled) return;
+
+    SnapPoolWriter pool;
+    vector<SnapMember> ms;
+    vector<SnapProduct> ps;
+    vector<SnapBooking> bs;
+    vector<SnapItem> items;
+    vector<SnapStr> fbs, others;
+    vector<int32_t> months;
+    for (int month : hotSegmentMonths()) months.push_back(month);
+
+    for (const auto& m : members)
+        ms.push_back({ pool.add(m.name), pool.add(m.phone), pool.add(m.type), m.joinDate, m.expiryDate });
+    for (const auto& p : inventory)
+        ps.push_back({ p.id, p.stock, p.priceCents, pool.add(p.name) });
+    for (const auto& b : allBookings) {
+        if (b.cancelled || !binary_search(months.begin(), months.end(), monthIndexOf(b.day))) continue;
+        SnapBooking r{};
+        r.bookingID = b.bookingID;
+        r.firstItem = (uint32_t)items.size();
+        r.itemCount = (uint32_t)b.items.size();
+        r.totalCents = b.totalCents;
+        r.customerName = pool.add(customerText(b.customerName));
+        r.customerPhone = pool.add(customerText(b.customerPhone));
+        r.day = b.day;
+        r.minute = b.minute;
+        bs.push_back(r);
+        for (const auto& it : b.items) {
+            SnapItem si{};
+            si.kind = (uint8_t)it.kind;
+            si.slotStart = it.slotStart;
+            si.slotEnd = it.slotEnd;
+            si.court = (uint8_t)it.court;
+            si.refId = it.refId;
+            si.qty = it.qty;
+            si.date = it.date;
+            si.unitCents = it.unitCents;
+            items.push_back(si);
+        }
+    }
+    for (const auto& f : feedbackList) fbs.push_back(pool.add(f));
+    for (const auto& o : otherItemNames) others.push_back(pool.add(o));
+
+    SnapHeader h{};
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.memberCount = (uint32_t)ms.size();
+    h.productCount = (uint32_t)ps.size();
+    h.bookingCount = (uint32_t)bs.size();
+    h.itemCount = (uint32_t)items.size();
+    h.feedbackCount = (uint32_t)fbs.size();
+    h.otherNameCount = (uint32_t)others.size();
+    h.segmentCount = (uint32_t)months.size();
+    h.nextBookingID = nextBookingID;
+    h.poolSize = pool.data().size();
+
+    // On failure the old snapshot stays, older than the text files, and is skipped
+    writeFileAtomic(FILE_SNAPSHOT, [&](ostream& out) {
+        writeRaw(out, h);
+        for (const auto& r : ms) writeRaw(out, r);
+        for (const auto& r : ps) writeRaw(out, r);
+        for (const auto& r : bs) writeRaw(out, r);
+        for (const auto& r : items) writeRaw(out, r);
+        for (const auto& r : fbs) writeRaw(out, r);
+        for (const auto& r : others) writeRaw(out, r);
+        for (const auto& r : months) writeRaw(out, r);
+        out.write(pool.data().data(), (streamsize)pool.data().size());
+    }, ios::out | ios::binary);
+}
+
+// Read-only view of a whole file, memory-mapped where the OS allows it
+class MappedFile {
+public:
+    explicit MappedFile(const char* path) {
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return;
+        base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (base) len = (size_t)sz.QuadPart;
+#else
+        fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) return;
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) return;
+        base = (const char*)p;
+        len = (size_t)st.st_size;
+#endif
+    }
+    ~MappedFile() {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (base) munmap((void*)base, len);
+        if (fd >= 0) close(fd);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return base; }
+    size_t size() const { return len; }
+
+private:
+    const char* base = nullptr;
+    size_t len = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+static bool snapshotIsCurrent() {
+    namespace fs = std::filesystem;
+    error_code ec;
+    auto snapTime = fs::last_write_time(FILE_SNAPSHOT, ec);
+    if (ec) return false;
+    for (const char* f : { FILE_MEMBERS, FILE_INVENTORY, FILE_BOOKINGS, FILE_FEEDBACKS }) {
+        auto t = fs::last_write_time(f, ec);
+        if (!ec && t > snapTime) return false; // text was edited/imported after the checkpoint
+    }
+    for (const auto& entry : fs::directory_iterator(DIR_BOOKING_SEGMENTS, ec)) {
+        if (entry.path().extension() != ".txt") continue; // leftover .tmp files
+        auto t = entry.last_write_time(ec);
+        if (!ec && t > snapTime) return false;
+    }
+    return true;
+}
+
+// Fill members/inventory/bookings/feedback from the snapshot, and months with
+// the segment months its bookings cover. Returns false (and leaves them
+// empty) if the snapshot can't be used.
+bool loadSnapshot(vector<int>& months) {
+    if (!snapshotEnabled || !snapshotIsCurrent()) return false;
+
+    MappedFile f(FILE_SNAPSHOT);
+    if (!f.data() || f.size() < sizeof(SnapHeader)) return false;
+
+    SnapHeader h;
+    memcpy(&h, f.data(), sizeof(h));
+    if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.version != SNAPSHOT_VERSION) return false;
+
+    uint64_t need = sizeof(SnapHeader)
+        + (uint64_t)h.memberCount * sizeof(SnapMember)
+        + (uint64_t)h.productCount * sizeof(SnapProduct)
+        + (uint64_t)h.bookingCount * sizeof(SnapBooking)
+        + (uint64_t)h.itemCount * sizeof(SnapItem)
+        + (uint64_t)h.feedbackCount * sizeof(SnapStr)
+        + (uint64_t)h.otherNameCount * sizeof(SnapStr)
+        + (uint64_t)h.segmentCount * sizeof(int32_t)
+        + h.poolSize;
+    if (need != f.size()) return false;
+
+    const char* cur = f.data() + sizeof(SnapHeader);
+    const char* pool = f.data() + (f.size() - h.poolSize);
+    bool ok = true;
+    auto view = [&](const SnapStr& r) {
+        if ((uint64_t)r.off + r.len > h.poolSize) { ok = false; return string_view(); }
+        return string_view(pool + r.off, r.len);
+    };
+    auto str = [&](const SnapStr& r) { return string(view(r)); };
+    auto next = [&](auto& rec) { memcpy(&rec, cur, sizeof(rec)); cur += sizeof(rec); };
+
+    members.reserve(h.memberCount);
+    for (uint32_t i = 0; i < h.memberCount; i++) {
+        SnapMember r; next(r);
+        members.push_back({ str(r.name), str(r.phone), str(r.type), r.joinDate, r.expiryDate });
+    }
+    inventory.reserve(h.productCount);
+    for (uint32_t i = 0; i < h.productCount; i++) {
+        SnapProduct r; next(r);
+        inventory.push_back({ r.id, str(r.name), r.priceCents, r.stock });
+    }
+    rebuildProductCatalog();
+    vector<SnapBooking> bs(h.bookingCount);
+    for (auto& r : bs) next(r);
+    vector<SnapItem> items(h.itemCount);
+    for (auto& r : items) next(r);
+    vector<SnapStr> fbs(h.feedbackCount);
+    for (auto& r : fbs) next(r);
+
+    // Unmapped legacy item names, re-interned so ids match this process
+    vector<int> otherIds(h.otherNameCount);
+    for (auto& id : otherIds) {
+        SnapStr r; next(r);
+        id = internOtherName(str(r));
+    }
+    months.resize(h.segmentCount);
+    for (auto& m : months) { int32_t r; next(r); m = r; }
+
+    allBookings.reserve(h.bookingCount);
+    for (const auto& r : bs) {
+        if ((uint64_t)r.firstItem + r.itemCount > h.itemCount) { ok = false; break; }
+        BookingRecord b;
+        b.bookingID = r.bookingID;
+        b.customerName = customerStrings.intern(view(r.customerName));
+        b.customerPhone = customerStrings.intern(view(r.customerPhone));
+        b.day = r.day;
+        b.minute = r.minute;
+        b.totalCents = r.totalCents;
+        b.items.reserve(r.itemCount);
+        for (uint32_t k = 0; k < r.itemCount; k++) {
+            const SnapItem& si = items[r.firstItem + k];
+            if (si.kind > (uint8_t)ItemKind::Other) { ok = false; break; } // indexes per-kind tables
+            LineItem it;
+            it.kind = (ItemKind)si.kind;
+            it.refId = si.refId;
+            it.qty = si.qty;
+            it.unitCents = si.unitCents;
+            it.date = si.date;
+            it.slotStart = si.slotStart;
+            it.slotEnd = si.slotEnd;
+            it.court = si.court < MAX_COURTS ? si.court : 0;
+            if (it.kind == ItemKind::Other) {
+                if (si.refId < 0 || (uint32_t)si.refId >= h.otherNameCount) { ok = false; break; }
+                it.refId = otherIds[si.refId];
+            }
+            b.items.push_back(it);
+        }
+        allBookings.push_back(move(b));
+    }
+    for (const auto& r : fbs) feedbackList.push_back(str(r));
+
+    if (!ok) {
+        members.clear(); inventory.clear(); allBookings.clear(); feedbackList.clear(); months.clear();
+        return false;
+    }
+    nextBookingID = max(nextBookingID.load(), (int)h.nextBookingID);
+    return true;
+}
+
+int64_t replayJournal();
+void resumeJournal(int64_t goodSize);
+void rebuildBookingIndexes();
+void loadBookingSegments(const vector<int>& loadedMonths);
+bool saveBookingSegments(uint64_t& bytes);
+int findBookingSlot(int bookingID);
+int appendBooking(const BookingRecord& b);
+void cancelBooking(int slot);
+void compactBookings();
+
+void loadTextFiles() {
+    // Members
+    {
+        ifstream memberFile(FILE_MEMBERS);
+        if (memberFile) {
+            Member m;
+            while (readMember(memberFile, m)) {
+                if (!m.name.empty()) members.push_back(m);
+            }
+        }
+    }
+
+    // Inventory
+    {
+        ifstream invFile(FILE_INVENTORY);
+        if (invFile) {
+            Product p;
+            while (readProduct(invFile, p)) inventory.push_back(p);
+            rebuildProductCatalog(); // bookings below may need product names
+        }
+        else {
+            loadDefaultsInventory();
+        }
+    }
+
+    // Bookings: only a legacy single file here; segments load in loadData
+    {
+        ifstream bookFile(FILE_BOOKINGS);
+        if (bookFile) {
+            BookingRecord b;
+            while (readBookingRecord(bookFile, b)) {
+                allBookings.push_back(b);
+
+                if (b.bookingID >= nextBookingID)
+                    nextBookingID = b.bookingID + 1;
+            }
+        }
+    }
+
+    // Feedback
+    {
+        ifstream feedFile(FILE_FEEDBACKS);
+        if (feedFile) {
+            string line;
+            while (getline(feedFile, line)) {
+                line = trimCopy(line);
+                if (!line.empty()) feedbackList.push_back(line);
+            }
+        }
+    }
+
+}
+
+void loadData() {
+    ScopedTimer timer(Metric::LoadData);
+    vector<int> snapshotMonths;
+    if (!loadSnapshot(snapshotMonths)) loadTextFiles();
+    loadBookingSegments(snapshotMonths);
+    rebuildMemberIndex();
+    rebuildBookingIndexes();
+
+    // Changes made since the last checkpoint
+    int64_t replayed = replayJournal();
+    resumeJournal(replayed);
+}
+
+// Every file goes through writeFileAtomic. Returns false if any of them could
+// not be written; those keep their previous content.
+bool saveData() {
+    ScopedTimer timer(Metric::SaveData);
+    uint64_t bytes = 0;
+    bool ok = true;
+    auto account = [&](int64_t written) {
+        if (written < 0) ok = false;
+        else bytes += (uint64_t)written;
+    };
+    account(writeFileAtomic(FILE_MEMBERS, [](ostream& out) {
+        for (const auto& m : members) writeMember(out, m);
+    }));
+    account(writeFileAtomic(FILE_INVENTORY, [](ostream& out) {
+        for (const auto& item : inventory) writeProduct(out, item);
+    }));
+    if (!saveBookingSegments(bytes)) ok = false;
+    account(writeFileAtomic(FILE_FEEDBACKS, [](ostream& out) {
+        for (const auto& f : feedbackList) out << f << "\n";
+    }));
+    counters.bytesSaved += bytes;
+
+    if (ok) cout << "[System] All data saved successfully.\n";
+    else cout << "[System] ERROR: some data files could not be written; the journal keeps the changes.\n";
+    return ok;
+}
+
+// ================= TRANSACTION JOURNAL =================
+// Each mutation appends one small record to the journal instead of rewriting
+// every data file. loadData replays it on top of the last checkpoint, and
+// checkpoint() folds it back into the data files every JOURNAL_CHECKPOINT_EVERY
+// records and on exit. A record is only applied if its END line made it to disk.
+//
+// Records are fsynced before the sale is confirmed, but not one by one: a
+// flusher thread writes and syncs everything queued since its last flush in
+// one go, so the checkouts that arrive while an fsync is in progress share the
+// next one. Lanes wait for their record after releasing storeMutex.
+// --group-commit-ms=N makes the flusher gather for N ms first, for disks where
+// an fsync costs more than the wait.
+const char* FILE_JOURNAL = "journal.txt";
+const int JOURNAL_CHECKPOINT_EVERY = 500;
+const size_t GROUP_COMMIT_BYTES = 64 * 1024; // flush early once a batch is this big
+
+class JournalWriter {
+public:
+    int groupCommitMs = 0;
+
+    ~JournalWriter() {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (flusher.joinable()) flusher.join();
+        closeFile();
+    }
+
+    // Queue a whole record; returns the ticket to wait on
+    uint64_t append(const string& record) {
+        lock_guard<mutex> lock(m);
+        if (!flusher.joinable()) flusher = thread(&JournalWriter::flushLoop, this);
+        pending += record;
+        uint64_t ticket = ++appended;
+        wake.notify_all();
+        return ticket;
+    }
+
+    enum class State { Pending, Durable, Failed };
+
+    State state(uint64_t ticket) {
+        lock_guard<mutex> lock(m);
+        if (flushed < ticket) return State::Pending;
+        return failedTicket(ticket) ? State::Failed : State::Durable;
+    }
+
+    // Block until the batch holding this ticket was flushed. False if that
+    // flush failed: the record is not in the journal.
+    bool waitDurable(uint64_t ticket) {
+        unique_lock<mutex> lock(m);
+        done.wait(lock, [&] { return flushed >= ticket || !flusher.joinable(); });
+        return flushed >= ticket && !failedTicket(ticket);
+    }
+
+    void drain() {
+        uint64_t ticket;
+        {
+            lock_guard<mutex> lock(m);
+            ticket = appended;
+        }
+        waitDurable(ticket);
+    }
+
+    // A byte is written to fd after every flush, so an event loop polling its
+    // other end learns that tickets may have settled (-1 = off)
+    void setFlushNotify(int fd) {
+        lock_guard<mutex> lock(m);
+        notifyFd = fd;
+    }
+
+    // Append after the first size bytes: whatever follows the last record a
+    // replay accepted (a crash mid-write) is cut off first
+    void resumeAt(int64_t size) {
+        lock_guard<mutex> lock(m);
+        closeFile();
+        goodSize = size;
+        torn = true;
+        if (openFile(false)) cutBack(); // retried before the first batch if it fails now
+    }
+
+    // Empty the journal once its records are in the data files
+    void truncate() {
+        unique_lock<mutex> lock(m);
+        done.wait(lock, [&] { return flushed >= appended || !flusher.joinable(); });
+        closeFile();
+        goodSize = -1; // measured again on open
+        torn = false;
+        if (openFile(true)) syncJournal();
+    }
+
+private:
+    mutex m;
+    condition_variable wake, done;
+    string pending;
+    uint64_t appended = 0, flushed = 0;
+    vector<pair<uint64_t, uint64_t>> failed; // ticket ranges of failed flushes
+    bool stopping = false;
+    int notifyFd = -1;
+    thread flusher;
+    // Journal size after the last good flush. A failed flush may leave part
+    // of its batch behind; torn says the file must be cut back to goodSize
+    // before anything else is appended, so replay never stops at it.
+    int64_t goodSize = -1; // -1 = not known yet
+    bool torn = false;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+
+    void flushLoop() {
+        unique_lock<mutex> lock(m);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || !pending.empty(); });
+            if (pending.empty()) break; // stopping
+            // Let more records join the batch
+            if (groupCommitMs > 0 && !stopping)
+                wake.wait_for(lock, chrono::milliseconds(groupCommitMs),
+                    [&] { return stopping || pending.size() >= GROUP_COMMIT_BYTES; });
+
+            string batch;
+            batch.swap(pending);
+            uint64_t from = flushed + 1, upTo = appended;
+            lock.unlock();
+            bool ok;
+            {
+                ScopedTimer timer(Metric::JournalFlush);
+                ok = writeBatch(batch);
+            }
+            lock.lock();
+            if (ok) counters.journalBytes += batch.size();
+            else {
+                cout << "[System] ERROR: could not write " << FILE_JOURNAL << "; " << (upTo - from + 1) << " change(s) rejected.\n";
+                failed.emplace_back(from, upTo);
+            }
+            flushed = upTo;
+            counters.journalFlushes++;
+            done.notify_all();
+#ifndef _WIN32
+            if (notifyFd >= 0 && write(notifyFd, "", 1) < 0) {} // full pipe: a wakeup is already queued
+#endif
+        }
+    }
+
+    bool failedTicket(uint64_t ticket) const {
+        for (const auto& r : failed)
+            if (ticket >= r.first && ticket <= r.second) return true;
+        return false;
+    }
+
+    // Only the flusher (or truncate, with the queue drained) touches the file
+    bool writeBatch(const string& batch) {
+        if (!openFile(false)) return false;
+        if (torn && !cutBack()) return false;
+        if (!writeAll(batch) || !syncJournal()) {
+            torn = true;
+            cutBack(); // retried before the next batch if it fails now
+            return false;
+        }
+        goodSize += (int64_t)batch.size();
+        return true;
+    }
+
+    bool writeAll(const string& batch) {
+#ifdef _WIN32
+        LARGE_INTEGER zero{};
+        DWORD written = 0;
+        return SetFilePointerEx(file, zero, nullptr, FILE_END)
+            && WriteFile(file, batch.data(), (DWORD)batch.size(), &written, nullptr) && written == batch.size();
+#else
+        size_t off = 0;
+        while (off < batch.size()) {
+            ssize_t n = write(fd, batch.data() + off, batch.size() - off);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            off += (size_t)n;
+        }
+        return true;
+#endif
+    }
+
+    // Drop whatever a failed flush left after the last good record
+    bool cutBack() {
+#ifdef _WIN32
+        LARGE_INTEGER at;
+        at.QuadPart = goodSize;
+        bool ok = SetFilePointerEx(file, at, nullptr, FILE_BEGIN) && SetEndOfFile(file) && syncJournal();
+#else
+        bool ok = ftruncate(fd, (off_t)goodSize) == 0 && syncJournal();
+#endif
+        if (ok) torn = false;
+        return ok;
+    }
+
+    bool openFile(bool trunc) {
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) return true;
+        file = CreateFileA(FILE_JOURNAL, GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+            trunc ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (goodSize < 0) goodSize = GetFileSizeEx(file, &size) ? (int64_t)size.QuadPart : 0;
+        return true;
+#else
+        if (fd >= 0) return true;
+        fd = open(FILE_JOURNAL, O_WRONLY | O_APPEND | O_CREAT | (trunc ? O_TRUNC : 0), 0644);
+        if (fd < 0) return false;
+        if (goodSize < 0) goodSize = max<int64_t>(0, (int64_t)lseek(fd, 0, SEEK_END));
+        return true;
+#endif
+    }
+
+    bool syncJournal() {
+#ifdef _WIN32
+        return FlushFileBuffers(file) != 0;
+#elif defined(__APPLE__)
+        return fsync(fd) == 0;
+#else
+        return fdatasync(fd) == 0;
+#endif
+    }
+
+    void closeFile() {
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) close(fd);
+        fd = -1;
+#endif
+    }
+};
+
+JournalWriter journal;
+ostringstream journalRecord; // record being built, appended whole by journalEnd
+int journalRecords = 0;
+thread_local uint64_t journalTicket = 0; // this thread's last record
+
+// Off for headless replays that must not touch the data files
+bool persistenceEnabled = true;
+
+// Headless replays leave journal.txt as it is
+void resumeJournal(int64_t goodSize) {
+    if (persistenceEnabled) journal.resumeAt(goodSize);
+}
+
+// A sale or refund whose journal record is still being flushed. settle runs
+// exactly once, under storeMutex, with the record's fate: a sale is applied
+// first and voided if its record failed, a refund is only applied once its
+// record is on disk. The lane that made it settles it after waiting; a
+// checkpoint that gets there first settles it before saving, so the data
+// files never hold a sale the customer was told failed, nor miss a refund
+// that was confirmed.
+struct PendingCommit {
+    uint64_t ticket = 0;
+    int refundId = 0; // booking a pending refund is for
+    function<void(bool durable)> settle;
+    bool settled = false, durable = false;
+    vector<LineItem> cartItems; // a voided sale gives the lane its cart back
+    Cents cartCents = 0;
+};
+
+vector<shared_ptr<PendingCommit>> pendingCommits; // guarded by storeMutex
+
+// Caller holds storeMutex
+static void settleCommit(PendingCommit& pc, bool durable) {
+    if (pc.settled) return;
+    pc.settled = true;
+    pc.durable = durable;
+    if (pc.settle) pc.settle(durable);
+    pendingCommits.erase(remove_if(pendingCommits.begin(), pendingCommits.end(),
+        [&](const shared_ptr<PendingCommit>& p) { return p.get() == &pc; }), pendingCommits.end());
+}
+
+// Caller holds storeMutex
+static bool refundPending(int bookingID) {
+    for (const auto& pc : pendingCommits)
+        if (pc->refundId == bookingID) return true;
+    return false;
+}
+
+// The journal is only emptied once the data files hold everything in it; if
+// a save fails it stays and is replayed on the next start. False if the save
+// failed.
+bool checkpoint() {
+    if (!persistenceEnabled) return true;
+    journal.drain();
+    journalRecords = 0; // before the settles below, which may journal restocks
+    vector<shared_ptr<PendingCommit>> settling = pendingCommits;
+    for (const auto& pc : settling) settleCommit(*pc, journal.state(pc->ticket) == JournalWriter::State::Durable);
+    compactBookings();
+    if (saveData()) {
+        writeSnapshot(); // after the text files, so it is never older than them
+        journal.truncate();
+        return true;
+    }
+    return false;
+}
+
+static ostream& journalBegin(const char* tag) {
+    journalRecord.str("");
+    journalRecord << tag << "\n";
+    return journalRecord;
+}
+
+// pc, if given, is registered with the record's ticket before any checkpoint
+// this record triggers
+static void journalEnd(const shared_ptr<PendingCommit>& pc = nullptr) {
+    if (!persistenceEnabled) {
+        if (pc) settleCommit(*pc, true);
+        return;
+    }
+    ScopedTimer timer(Metric::JournalAppend);
+    journalRecord << "END\n";
+    journalTicket = journal.append(journalRecord.str());
+    if (pc) {
+        pc->ticket = journalTicket;
+        pendingCommits.push_back(pc);
+    }
+    if (++journalRecords >= JOURNAL_CHECKPOINT_EVERY) checkpoint();
+}
+
+// Wait until this thread's journal records are on disk. Called before telling
+// the customer it worked, and never while holding storeMutex. False if the
+// last record could not be written.
+bool journalSync() {
+    if (!persistenceEnabled || journalTicket == 0) return true;
+    return journal.waitDurable(journalTicket);
+}
+
+// Settles pc from the lane that made it (unless a checkpoint already did);
+// a voided sale puts the cart back into session. False if the record did
+// not make it.
+static bool settleFromLane(PosSession& session, PendingCommit& pc, bool durable) {
+    {
+        lock_guard<mutex> lock(storeMutex);
+        settleCommit(pc, durable);
+        durable = pc.durable;
+    }
+    if (!durable && !pc.cartItems.empty()) {
+        session.cartItems = move(pc.cartItems);
+        session.cartCents = pc.cartCents;
+    }
+    return durable;
+}
+
+// Waits for pc's record and settles it. A session that defers gets it back
+// in heldCommit instead and answers later (true for now). Never called while
+// holding storeMutex.
+bool finishCommit(PosSession& session, const shared_ptr<PendingCommit>& pc) {
+    if (session.deferCommits) {
+        session.heldCommit = pc;
+        return true;
+    }
+    return settleFromLane(session, *pc, journal.waitDurable(pc->ticket));
+}
+
+// For a session that defers: once the flusher is done with its held commit,
+// settle it and report the outcome in durable. False while still in flight.
+bool settleHeldCommit(PosSession& session, bool& durable) {
+    JournalWriter::State state = journal.state(session.heldCommit->ticket);
+    if (state == JournalWriter::State::Pending) return false;
+    durable = settleFromLane(session, *session.heldCommit, state == JournalWriter::State::Durable);
+    session.heldCommit.reset();
+    return true;
+}
+
+void journalSale(const BookingRecord& b, const shared_ptr<PendingCommit>& pc) {
+    writeBookingRecord(journalBegin("SALE"), b);
+    journalEnd(pc);
+}
+
+// refund = customer cancellation (stock goes back), otherwise admin removal
+void journalCancel(int bookingID, bool refund, const shared_ptr<PendingCommit>& pc = nullptr) {
+    journalBegin(refund ? "REFUND" : "REMOVE") << bookingID << "\n";
+    journalEnd(pc);
+}
+
+void journalStock(const Product& p) {
+    journalBegin("STOCK") << p.id << "\n" << p.stock << "\n";
+    journalEnd();
+}
+
+void journalProduct(const Product& p) {
+    writeProduct(journalBegin("PRODUCT"), p);
+    journalEnd();
+}
+
+void journalMemberAdd(const Member& m) {
+    writeMember(journalBegin("MEMBER"), m);
+    journalEnd();
+}
+
+void journalMemberRemove(const string& phone) {
+    journalBegin("UNMEMBER") << phone << "\n";
+    journalEnd();
+}
+
+// index is the line's position in feedbackList, so a replay can tell the
+// lines the data files already hold
+void journalFeedback(size_t index, const string& line) {
+    journalBegin("FEEDBACK") << index << "\n" << line << "\n";
+    journalEnd();
+}
+
+// Every record replays idempotently on top of data files that may already
+// hold it (a crash between saveData and the truncate): sales are skipped by
+// ID, stock and products are absolute, feedback goes by position. Returns
+// the journal size up to the end of the last good record.
+int64_t replayJournal() {
+    ifstream in(FILE_JOURNAL, ios::binary);
+    if (!in) return 0;
+    int64_t good = 0;
+
+    string tag, endLine;
+    // An END without its newline is torn too: the next append would run into it
+    auto ended = [&] { return getline(in, endLine) && endLine == "END" && !in.eof(); };
+    while (getline(in, tag)) {
+        bool ok = true;
+
+        if (tag == "SALE") {
+            BookingRecord b;
+            ok = readBookingRecord(in, b) && ended();
+            // skip sales that already made it into the last checkpoint
+            if (ok && findBookingSlot(b.bookingID) < 0) appendBooking(b);
+        }
+        else if (tag == "REFUND" || tag == "REMOVE") {
+            int id;
+            ok = (in >> id) && in.ignore() && ended();
+            int slot = ok ? findBookingSlot(id) : -1;
+            if (slot >= 0) cancelBooking(slot); // a refund's restock follows as STOCK records
+        }
+        else if (tag == "STOCK") {
+            int id, stock;
+            ok = (in >> id >> stock) && in.ignore() && ended();
+            if (ok) {
+                if (Product* p = findProduct(id)) p->stock = stock;
+            }
+        }
+        else if (tag == "PRODUCT") {
+            Product p;
+            ok = readProduct(in, p) && ended();
+            if (ok) {
+                if (Product* existing = findProduct(p.id)) {
+                    *existing = p;
+                    rebuildProductCatalog(); // name may have changed
+                }
+                else addProduct(p);
+            }
+        }
+        else if (tag == "MEMBER") {
+            Member m;
+            ok = readMember(in, m) && ended();
+            if (ok) upsertMember(m);
+        }
+        else if (tag == "UNMEMBER") {
+            string phone;
+            ok = getline(in, phone) && ended();
+            if (ok) removeMember(phone);
+        }
+        else if (tag == "FEEDBACK") {
+            size_t index;
+            string line;
+            ok = (in >> index) && in.ignore() && getline(in, line) && ended();
+            if (ok && index >= feedbackList.size()) feedbackList.push_back(line);
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) break; // torn or unknown record: stop at the last good one
+        journalRecords++;
+        good = (int64_t)in.tellg();
+    }
+    return good;
+}
+
+// ================= REPORT HELPERS =================
+struct TopSeller {
+    string name;
+    int sold = 0;
+};
+
+// Ranking order: more sold first, then by name
+static bool sellsBetter(const TopSeller& a, const TopSeller& b) {
+    return a.sold != b.sold ? a.sold > b.sold : a.name < b.name;
+}
+
+string sellerString(const TopSeller& t) {
+    return t.name + " (" + to_string(t.sold) + " sold)";
+}
+
+// ================= BOOKING COLUMNS =================
+// Column copy of the booking fields that analytics scans read, one row per
+// allBookings slot. A scan over days and totals streams a few flat arrays
+// instead of dragging every record's names and item vector through the
+// cache. Line items keep only what the sales counts need, in their own
+// columns indexed through itemBegin; rowsByDay lists each day's rows for
+// date lookups. Maintained by appendBooking,
+// cancelBooking and compactBookings; rebuilt with the other indexes.
+struct BookingColumns {
+    vector<DayNum> day;         // NO_DATE for cancelled rows
+    vector<Cents> totalCents;
+    vector<uint32_t> itemBegin; // row i's items are [itemBegin[i], itemBegin[i + 1])
+    vector<uint8_t> itemKind;
+    vector<int32_t> itemRef;
+    vector<int32_t> itemQty;
+    vector<Cents> itemCents;    // line total
+    unordered_map<DayNum, vector<int>> rowsByDay; // rows sold on each day, cancelled ones included
+
+    size_t rows() const { return day.size(); }
+};
+
+BookingColumns bookingCols;
+
+void appendBookingColumns(const BookingRecord& b) {
+    BookingColumns& c = bookingCols;
+    if (c.itemBegin.empty()) c.itemBegin.push_back(0);
+    c.day.push_back(b.cancelled ? NO_DATE : b.day);
+    c.totalCents.push_back(b.totalCents);
+    if (!b.cancelled) c.rowsByDay[b.day].push_back((int)c.day.size() - 1);
+    for (const LineItem& it : b.items) {
+        c.itemKind.push_back((uint8_t)it.kind);
+        c.itemRef.push_back(it.refId);
+        c.itemQty.push_back(it.qty);
+        c.itemCents.push_back(it.lineCents());
+    }
+    c.itemBegin.push_back((uint32_t)c.itemKind.size());
+}
+
+void rebuildBookingColumns() {
+    bookingCols = BookingColumns();
+    size_t items = 0;
+    for (const auto& b : allBookings) items += b.items.size();
+    BookingColumns& c = bookingCols;
+    c.day.reserve(allBookings.size());
+    c.totalCents.reserve(allBookings.size());
+    c.itemBegin.reserve(allBookings.size() + 1);
+    c.itemKind.reserve(items);
+    c.itemRef.reserve(items);
+    c.itemQty.reserve(items);
+    c.itemCents.reserve(items);
+    for (const auto& b : allBookings) appendBookingColumns(b);
+}
+
+// Slots of the live bookings sold on one day, in history order
+vector<int> bookingSlotsOnDay(DayNum day) {
+    vector<int> slots;
+    auto found = bookingCols.rowsByDay.find(day);
+    if (day == NO_DATE || found == bookingCols.rowsByDay.end()) return slots;
+    for (int row : found->second)
+        if (bookingCols.day[row] == day) slots.push_back(row);
+    return slots;
+}
+
+// ================= REPORT AGGREGATES =================
+// Running totals per day and per month, updated on
+// every checkout and reversed on refund/removal, so opening a report only
+// reads these instead of walking the booking history.
+struct SalesAggregate {
+    int totalTransactions = 0;
+    Cents salesCents = 0;
+    multiset<Cents> bills;                    // every bill, for the highest one
+    map<pair<int, int>, int> itemCounts;      // (ItemKind, refId) -> qty sold
+};
+
+map<int, SalesAggregate> dailyAgg;   // by DayNum
+map<int, SalesAggregate> monthlyAgg; // by monthIndexOf
+
+static void applyBill(SalesAggregate& a, Cents bill, int sign) {
+    a.totalTransactions += sign;
+    a.salesCents += sign * bill;
+    if (sign > 0) a.bills.insert(bill);
+    else {
+        auto it = a.bills.find(bill);
+        if (it != a.bills.end()) a.bills.erase(it);
+    }
+}
+
+static void applyItem(SalesAggregate& a, ItemKind kind, int refId, int qty, int sign) {
+    // For "best" stats, ignore lockers
+    if (kind == ItemKind::Locker) return;
+
+    pair<int, int> k((int)kind, refId);
+    int& count = a.itemCounts[k];
+    count += sign * max(1, qty);
+    if (count <= 0) a.itemCounts.erase(k);
+}
+
+static void applyToAggregate(map<int, SalesAggregate>& aggs, int key, const BookingRecord& b, int sign) {
+    SalesAggregate& a = aggs[key];
+    applyBill(a, b.totalCents, sign);
+    for (const LineItem& item : b.items) applyItem(a, item.kind, item.refId, item.qty, sign);
+    if (a.totalTransactions <= 0) aggs.erase(key);
+}
+
+void applyToReportAggregates(const BookingRecord& b, int sign) {
+    if (b.day == NO_DATE) return;
+    applyToAggregate(dailyAgg, b.day, b, sign);
+    applyToAggregate(monthlyAgg, monthIndexOf(b.day), b, sign);
+}
+
+// Worker threads for a full rebuild (0 = one per core). Set with --report-threads=N.
+int reportThreads = 0;
+const size_t MIN_BOOKINGS_PER_REPORT_THREAD = 50000;
+
+using ItemCount = pair<pair<int, int>, int>; // ((ItemKind, refId), qty)
+
+// Map from unsorted (key, qty) pairs: sort, fold duplicates, build in one pass
+static map<pair<int, int>, int> countMap(vector<ItemCount>& counts) {
+    sort(counts.begin(), counts.end());
+    map<pair<int, int>, int> out;
+    for (size_t i = 0; i < counts.size();) {
+        size_t j = i;
+        int total = 0;
+        for (; j < counts.size() && counts[j].first == counts[i].first; j++) total += counts[j].second;
+        out.emplace_hint(out.end(), counts[i].first, total);
+        i = j;
+    }
+    return out;
+}
+
+// Aggregate for one run of rows sold on the same day; rows are (day, row) keys
+static SalesAggregate aggregateRows(const uint64_t* rows, size_t count) {
+    const BookingColumns& c = bookingCols;
+    SalesAggregate a;
+    vector<Cents> bills;
+    vector<ItemCount> items;
+    bills.reserve(count);
+    for (size_t r = 0; r < count; r++) {
+        uint32_t i = (uint32_t)rows[r];
+        a.salesCents += c.totalCents[i];
+        bills.push_back(c.totalCents[i]);
+        for (uint32_t k = c.itemBegin[i]; k < c.itemBegin[i + 1]; k++) {
+            if ((ItemKind)c.itemKind[k] == ItemKind::Locker) continue; // not in "best" stats
+            items.push_back({ { c.itemKind[k], c.itemRef[k] }, max(1, c.itemQty[k]) });
+        }
+    }
+    a.totalTransactions = (int)count;
+    sort(bills.begin(), bills.end());
+    a.bills = multiset<Cents>(bills.begin(), bills.end()); // linear for sorted input
+    a.itemCounts = countMap(items);
+    return a;
+}
+
+// Full rebuild from the booking columns. The day column is sorted once
+// (day, row), so each day's aggregate is built from one contiguous run with
+// sorted bulk inserts instead of a map lookup per row, and months are folded
+// from the finished days. Large histories split the runs across threads by
+// whole days; every sum is an integer, so the outcome matches a serial pass.
+void rebuildReportAggregates() {
+    ScopedTimer timer(Metric::ReportRebuild);
+    dailyAgg.clear();
+    monthlyAgg.clear();
+
+    const BookingColumns& c = bookingCols;
+    vector<uint64_t> keys;
+    keys.reserve(c.rows());
+    for (size_t i = 0; i < c.rows(); i++)
+        if (c.day[i] != NO_DATE) keys.push_back(((uint64_t)(uint32_t)c.day[i] << 32) | i); // day numbers are >= 1
+    sort(keys.begin(), keys.end());
+    auto dayOf = [](uint64_t key) { return (DayNum)(key >> 32); };
+
+    // Start of each day's run, plus an end marker
+    vector<size_t> runs;
+    for (size_t i = 0; i < keys.size(); i++)
+        if (i == 0 || (keys[i] >> 32) != (keys[i - 1] >> 32)) runs.push_back(i);
+    runs.push_back(keys.size());
+    size_t dayCount = runs.size() - 1;
+
+    vector<SalesAggregate> days(dayCount);
+    size_t threads = reportThreads > 0 ? (size_t)reportThreads : max(1u, thread::hardware_concurrency());
+    threads = min(threads, max<size_t>(1, keys.size() / MIN_BOOKINGS_PER_REPORT_THREAD));
+    threads = min(threads, max<size_t>(1, dayCount));
+    auto build = [&](size_t from, size_t to) {
+        for (size_t d = from; d < to; d++) days[d] = aggregateRows(&keys[runs[d]], runs[d + 1] - runs[d]);
+    };
+    if (threads <= 1) build(0, dayCount);
+    else {
+        vector<thread> workers;
+        for (size_t t = 0; t < threads; t++)
+            workers.emplace_back(build, dayCount * t / threads, dayCount * (t + 1) / threads);
+        for (auto& w : workers) w.join();
+    }
+
+    // Days come out in calendar order, so months are contiguous runs of days
+    for (size_t d = 0; d < dayCount;) {
+        int month = monthIndexOf(dayOf(keys[runs[d]]));
+        SalesAggregate m;
+        vector<Cents> bills;
+        vector<ItemCount> items;
+        for (; d < dayCount && monthIndexOf(dayOf(keys[runs[d]])) == month; d++) {
+            SalesAggregate& a = days[d];
+            m.totalTransactions += a.totalTransactions;
+            m.salesCents += a.salesCents;
+            bills.insert(bills.end(), a.bills.begin(), a.bills.end());
+            items.insert(items.end(), a.itemCounts.begin(), a.itemCounts.end());
+            dailyAgg.emplace_hint(dailyAgg.end(), dayOf(keys[runs[d]]), move(a));
+        }
+        sort(bills.begin(), bills.end());
+        m.bills = multiset<Cents>(bills.begin(), bills.end());
+        m.itemCounts = countMap(items);
+        monthlyAgg.emplace_hint(monthlyAgg.end(), month, move(m));
+    }
+}
+
+// ================= SALES RANGE INDEX =================
+// Fenwick tree over day numbers for "sales from the 3rd to the 17th" style
+// questions: any date range costs two O(log days) prefix sums. Each cell
+// holds bill totals, the transaction count and line revenue per ItemKind.
+// It covers [salesRangeBase, salesRangeBase + capacity) and is rebuilt in
+// O(capacity) from the raw per-day cells when a day falls outside.
+const int ITEM_KIND_COUNT = (int)ItemKind::Other + 1;
+const char* const ITEM_KIND_NAMES[ITEM_KIND_COUNT] = { "Bookings", "Rentals", "Lockers", "Products", "Other" };
+
+struct SalesTotals {
+    Cents salesCents = 0;             // bills, after discounts and tax
+    int64_t transactions = 0;
+    Cents kindCents[ITEM_KIND_COUNT] = {}; // line totals, before discounts and tax
+
+    void add(const SalesTotals& o, int sign) {
+        salesCents += sign * o.salesCents;
+        transactions += sign * o.transactions;
+        for (int k = 0; k < ITEM_KIND_COUNT; k++) kindCents[k] += sign * o.kindCents[k];
+    }
+};
+
+vector<SalesTotals> salesByDay;   // raw cell per day, index = day - salesRangeBase
+vector<SalesTotals> salesFenwick; // 1-based tree over salesByDay
+DayNum salesRangeBase = NO_DATE;
+
+static void buildSalesFenwick() {
+    size_t n = salesByDay.size();
+    salesFenwick.assign(n + 1, SalesTotals());
+    for (size_t i = 1; i <= n; i++) {
+        salesFenwick[i].add(salesByDay[i - 1], +1);
+        size_t parent = i + (i & (0 - i));
+        if (parent <= n) salesFenwick[parent].add(salesFenwick[i], +1);
+    }
+}
+
+// Makes room for day, doubling the covered span as needed
+static void coverSalesDay(DayNum day) {
+    if (salesRangeBase != NO_DATE && day >= salesRangeBase && (size_t)(day - salesRangeBase) < salesByDay.size()) return;
+    DayNum lo = salesRangeBase == NO_DATE ? day : min(day, salesRangeBase);
+    DayNum hi = salesRangeBase == NO_DATE ? day : max(day, salesRangeBase + (DayNum)salesByDay.size() - 1);
+    size_t cap = max<size_t>(64, salesByDay.size());
+    while (cap < (size_t)(hi - lo + 1)) cap *= 2;
+    // Grow towards whichever side needed it, leaving slack for later days
+    DayNum base = day < salesRangeBase ? hi - (DayNum)cap + 1 : lo;
+    base = max<DayNum>(base, 1);
+    vector<SalesTotals> cells(cap);
+    for (size_t i = 0; i < salesByDay.size(); i++) cells[salesRangeBase - base + i] = salesByDay[i];
+    salesByDay.swap(cells);
+    salesRangeBase = base;
+    buildSalesFenwick();
+}
+
+void addSalesDay(DayNum day, const SalesTotals& t, int sign) {
+    coverSalesDay(day);
+    size_t i = (size_t)(day - salesRangeBase);
+    salesByDay[i].add(t, sign);
+    for (size_t k = i + 1; k < salesFenwick.size(); k += k & (0 - k)) salesFenwick[k].add(t, sign);
+}
+
+SalesTotals salesTotalsOf(const BookingRecord& b) {
+    SalesTotals t;
+    t.salesCents = b.totalCents;
+    t.transactions = 1;
+    for (const LineItem& it : b.items) t.kindCents[(int)it.kind] += it.lineCents();
+    return t;
+}
+
+void applyToSalesRange(const BookingRecord& b, int sign) {
+    if (b.day == NO_DATE) return;
+    addSalesDay(b.day, salesTotalsOf(b), sign);
+}
+
+// Full rebuild from the booking columns
+void rebuildSalesRange() {
+    salesByDay.clear();
+    salesRangeBase = NO_DATE;
+    const BookingColumns& c = bookingCols;
+    DayNum lo = NO_DATE, hi = NO_DATE;
+    for (DayNum d : c.day) {
+        if (d == NO_DATE) continue;
+        if (lo == NO_DATE || d < lo) lo = d;
+        if (hi == NO_DATE || d > hi) hi = d;
+    }
+    if (lo == NO_DATE) { salesFenwick.clear(); return; }
+    salesRangeBase = lo;
+    salesByDay.assign(max<size_t>(64, (size_t)(hi - lo + 1) * 2), SalesTotals());
+    for (size_t i = 0; i < c.rows(); i++) {
+        if (c.day[i] == NO_DATE) continue;
+        SalesTotals& t = salesByDay[c.day[i] - lo];
+        t.salesCents += c.totalCents[i];
+        t.transactions++;
+        for (uint32_t k = c.itemBegin[i]; k < c.itemBegin[i + 1]; k++) t.kindCents[c.itemKind[k]] += c.itemCents[k];
+    }
+    buildSalesFenwick();
+}
+
+// Totals for days [base, base + count)
+static SalesTotals salesPrefix(size_t count) {
+    SalesTotals t;
+    for (size_t k = min(count, salesFenwick.size() - 1); k > 0; k -= k & (0 - k)) t.add(salesFenwick[k], +1);
+    return t;
+}
+
+// Totals for the inclusive day range [from, to]
+SalesTotals salesBetween(DayNum from, DayNum to) {
+    if (salesFenwick.empty() || from > to) return SalesTotals();
+    long long lo = max<long long>(0, (long long)from - salesRangeBase);
+    long long hi = (long long)to - salesRangeBase + 1;
+    if (hi <= lo) return SalesTotals();
+    SalesTotals t = salesPrefix((size_t)hi);
+    t.add(salesPrefix((size_t)lo), -1);
+    return t;
+}
+
+// Top k sellers of one category within an aggregate, best first. itemCounts
+// is ordered by (kind, refId), so only that category's slice is walked, through
+// a min-heap that never holds more than k entries: O(n log k), no temporary maps.
+vector<TopSeller> topSellers(const SalesAggregate& a, ItemKind kind, size_t k) {
+    vector<TopSeller> heap; // worst of the current top k at the front
+    if (k == 0) return heap;
+    heap.reserve(k + 1);
+    auto it = a.itemCounts.lower_bound({ (int)kind, INT_MIN });
+    for (; it != a.itemCounts.end() && it->first.first == (int)kind; ++it) {
+        if (it->second <= 0) continue;
+        if (heap.size() == k && heap.front().sold > it->second) continue;
+        LineItem line;
+        line.kind = kind;
+        line.refId = it->first.second;
+        TopSeller t{ itemName(line), it->second };
+        if (heap.size() == k) {
+            if (!sellsBetter(t, heap.front())) continue;
+            pop_heap(heap.begin(), heap.end(), sellsBetter);
+            heap.pop_back();
+        }
+        heap.push_back(move(t));
+        push_heap(heap.begin(), heap.end(), sellsBetter);
+    }
+    sort_heap(heap.begin(), heap.end(), sellsBetter);
+    return heap;
+}
+
+// Best seller of one category within an aggregate
+static string getBestItem(const SalesAggregate& a, ItemKind kind) {
+    vector<TopSeller> top = topSellers(a, kind, 1);
+    return top.empty() ? "-" : sellerString(top[0]);
+}
+
+// ================= BOOKING INDEXES =================
+// Everything derived from allBookings; call these whenever a booking is
+// added or removed so the indexes never drift from the history.
+void indexBooking(const BookingRecord& b) {
+    indexCourtBooking(b);
+    countEntryBooking(b, +1);
+    applyToReportAggregates(b, +1);
+    applyToSalesRange(b, +1);
+}
+
+void unindexBooking(const BookingRecord& b) {
+    unindexCourtBooking(b);
+    countEntryBooking(b, -1);
+    applyToReportAggregates(b, -1);
+    applyToSalesRange(b, -1);
+}
+
+// Booking ID -> slot in allBookings. IDs are handed out in increasing blocks
+// from nextBookingID, so a flat table offset by the lowest ID is enough.
+// Cancelled bookings stay in allBookings as tombstones (cancelled = true)
+// and are dropped in one pass by compactBookings at the next checkpoint,
+// instead of erasing from the middle of the vector on every refund.
+vector<int> bookingSlotById;
+int bookingIdBase = 1001;
+size_t bookingTombstones = 0;
+
+const int MAX_BOOKING_ID_SPAN = 50000000; // ids further out fall back to a scan
+
+static void setBookingSlot(int bookingID, int slot) {
+    long long off = (long long)bookingID - bookingIdBase;
+    if (off < 0 || off >= MAX_BOOKING_ID_SPAN) return;
+    if ((size_t)off >= bookingSlotById.size()) bookingSlotById.resize((size_t)off + 1, -1);
+    bookingSlotById[off] = slot;
+}
+
+static int findLoadedBookingSlot(int bookingID) {
+    long long off = (long long)bookingID - bookingIdBase;
+    if (off >= 0 && off < MAX_BOOKING_ID_SPAN) {
+        if ((size_t)off >= bookingSlotById.size()) return -1;
+        return bookingSlotById[off];
+    }
+    for (size_t i = 0; i < allBookings.size(); ++i)
+        if (!allBookings[i].cancelled && allBookings[i].bookingID == bookingID) return (int)i;
+    return -1;
+}
+
+bool loadSegmentsHolding(int bookingID);
+
+// Slot of a live booking, loading its month segment first if it is not in memory
+int findBookingSlot(int bookingID) {
+    int slot = findLoadedBookingSlot(bookingID);
+    if (slot < 0 && loadSegmentsHolding(bookingID)) slot = findLoadedBookingSlot(bookingID);
+    return slot;
+}
+
+// lowestId lowers the base further, for IDs about to be appended
+static void rebuildBookingSlots(int lowestId = INT_MAX) {
+    bookingSlotById.clear();
+    bookingIdBase = min<int>(nextBookingID, lowestId);
+    for (const auto& b : allBookings) bookingIdBase = min(bookingIdBase, b.bookingID);
+    for (size_t i = 0; i < allBookings.size(); i++)
+        if (!allBookings[i].cancelled) setBookingSlot(allBookings[i].bookingID, (int)i);
+}
+
+void noteSegmentSale(const BookingRecord& b);
+void noteSegmentCancel(const BookingRecord& b);
 
-    if (hasCode == 'N' || hasCode == 'n') return 0.0;
+int appendBooking(const BookingRecord& b) {
+    noteSegmentSale(b); // may load the month's older bookings first
+    allBookings.push_back(b);
+    int slot = (int)allBookings.size() - 1;
+    if (b.bookingID >= nextBookingID) nextBookingID = b.bookingID + 1;
+    setBookingSlot(b.bookingID, slot);
+    appendBookingColumns(b);
+    indexBooking(b);
+    return slot;
+}
 
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+void cancelBooking(int slot) {
+    BookingRecord& b = allBookings[slot];
+    if (b.cancelled) return;
+    unindexBooking(b);
+    noteSegmentCancel(b);
+    setBookingSlot(b.bookingID, -1);
+    bookingCols.day[slot] = NO_DATE;
+    b.cancelled = true;
+    bookingTombstones++;
+}
 
-    while (true) {
-        string code;
-        cout << "Enter promo code (or type EXIT to skip): ";
-        getline(cin, code);
-        code = trimCopy(code);
+// Drop tombstones; run at checkpoint time, off the refund path
+void compactBookings() {
+    if (bookingTombstones == 0) return;
+    allBookings.erase(remove_if(allBookings.begin(), allBookings.end(),
+        [](const BookingRecord& b) { return b.cancelled; }), allBookings.end());
+    bookingTombstones = 0;
+    rebuildBookingSlots();
+    rebuildBookingColumns();
+}
 
-        if (code == "EXIT") return 0.0;
+void registerLoadedSegments();
+void addColdSegmentTotals();
+
+void rebuildBookingIndexes() {
+    compactBookings();
+    registerLoadedSegments();
+    rebuildBookingSlots();
+    rebuildBookingColumns();
+    rebuildCourtSchedule();
+    rebuildEntryOccupancy();
+    rebuildReportAggregates();
+    rebuildSalesRange();
+    addColdSegmentTotals();
+}
 
-        // Support both versions + extra
-        if (code == "PROMO10") {
-            cout << ">> Promo applied: 10% OFF\n";
-            return subtotal * 0.10;
-        }
-        if (code == "DISC5" || code == "SPORT2025") {
-            cout << ">> Promo applied: RM 5 OFF\n";
-            return 5.0;
-        }
+// ================= BOOKING SEGMENTS =================
+// Booking history lives in one text file per sale month (bookings/2026-03.txt).
+// Each file opens with a small header: booking count, ID range, the last day
+// any of its bookings is used on, and per-day totals; the booking records
+// follow in the usual format. loadData reads every header but only the
+// records of hot segments: this month, later months, and any month that still
+// holds a court or entry for today or later. Older months load on demand (a
+// booking ID inside their range, a report on one of their days) and until
+// then feed the date-range index and the report aggregates from their header
+// figures, so startup time, memory and full reports follow the recent months
+// rather than the whole history. saveData only rewrites segments that
+// changed. A legacy bookings.txt is imported at load and split into segments
+// at the next save.
+struct BookingSegment {
+    bool loaded = false;
+    bool dirty = false;  // differs from its file
+    bool unreadable = false; // its file failed to load; never written from memory
+    int count = 0;
+    int firstId = INT_MAX, lastId = INT_MIN;
+    DayNum lastServiceDay = NO_DATE;
+    map<DayNum, SalesTotals> days; // header totals; only kept while not loaded
+    map<DayNum, SalesAggregate> reportDays; // header highest bill and item counts; read for full reports only
+    bool summarized = true; // false for files written before headers carried report figures
+};
 
-        cout << "ERROR! Invalid promo code.\n";
-    }
+map<int, BookingSegment> bookingSegments; // by monthIndexOf(sale day)
+
+string segmentPath(int month) {
+    return string(DIR_BOOKING_SEGMENTS) + "/" + monthString(month) + ".txt";
 }
 
-// ================= FILE HANDLING =================
-void loadDefaultsInventory() {
-    inventory.clear();
-    // Sports Products
-    inventory.push_back({ 201, "Badminton Racket", 100.00, 10 });
-    inventory.push_back({ 202, "Badminton Strings", 20.00, 20 });
-    inventory.push_back({ 203, "Shuttlecocks (12)", 70.00, 30 });
-    inventory.push_back({ 204, "Paddle", 100.00, 10 });
-    inventory.push_back({ 205, "Pickle Ball (6)", 50.00, 20 });
-    inventory.push_back({ 206, "Basketball", 100.00, 10 });
-    inventory.push_back({ 207, "Goggles", 20.00, 15 });
-    inventory.push_back({ 208, "Swim Cap", 5.00, 20 });
-    // Drinks & Snacks
-    inventory.push_back({ 301, "Mineral Water", 2.50, 99 });
-    inventory.push_back({ 302, "100 Plus / Coca-Cola", 4.00, 50 });
-    inventory.push_back({ 303, "Gatorade", 4.00, 40 });
-    inventory.push_back({ 304, "Jasmine / Lemon Tea", 3.50, 40 });
-    inventory.push_back({ 305, "Redbull", 5.00, 30 });
-    inventory.push_back({ 306, "Milo", 3.50, 40 });
-    inventory.push_back({ 307, "Protein Shake", 10.00, 20 });
-    inventory.push_back({ 308, "Biscuit", 5.00, 30 });
-    inventory.push_back({ 309, "Chocolate / Energy Bar", 3.50, 50 });
+static DayNum lastServiceDayOf(const BookingRecord& b) {
+    DayNum last = b.day;
+    for (const LineItem& it : b.items)
+        if (it.kind == ItemKind::Booking && it.date > last) last = it.date;
+    return last;
 }
 
-void loadData() {
-    // Members
-    {
-        ifstream memberFile(FILE_MEMBERS);
-        if (memberFile) {
-            Member m;
-            while (getline(memberFile, m.name)) {
-                getline(memberFile, m.phone);
-                getline(memberFile, m.type);
-                getline(memberFile, m.joinDate);
-                getline(memberFile, m.expiryDate);
-                if (!m.name.empty()) members.push_back(m);
-            }
-        }
+static void addToSegment(BookingSegment& s, const BookingRecord& b) {
+    s.count++;
+    s.firstId = min(s.firstId, b.bookingID);
+    s.lastId = max(s.lastId, b.bookingID);
+    s.lastServiceDay = max(s.lastServiceDay, lastServiceDayOf(b));
+}
+
+bool segmentIsHot(int month, const BookingSegment& s) {
+    DayNum now = today();
+    return month >= monthIndexOf(now) || s.lastServiceDay >= now;
+}
+
+// Header: "SEGMENT yyyy-mm", "COUNT n", "IDS first last", "SERVICE dd/mm/yyyy",
+// per day with sales one "DAY dd/mm/yyyy tx sales kind0..kind4 highest" and,
+// if anything counted was sold, "ITEMS dd/mm/yyyy kind ref qty ...", then "BEGIN".
+static void writeSegmentHeader(ostream& out, int month, const BookingSegment& s) {
+    out << "SEGMENT " << monthString(month) << "\n";
+    out << "COUNT " << s.count << "\n";
+    out << "IDS " << s.firstId << " " << s.lastId << "\n";
+    out << "SERVICE " << dateString(s.lastServiceDay) << "\n";
+    for (const auto& d : s.days) {
+        auto report = s.reportDays.find(d.first);
+        bool hasReport = report != s.reportDays.end();
+        out << "DAY " << dateString(d.first) << " " << d.second.transactions << " " << moneyString(d.second.salesCents);
+        for (int k = 0; k < ITEM_KIND_COUNT; k++) out << " " << moneyString(d.second.kindCents[k]);
+        out << " " << moneyString(hasReport && !report->second.bills.empty() ? *report->second.bills.rbegin() : 0) << "\n";
+        if (!hasReport || report->second.itemCounts.empty()) continue;
+        out << "ITEMS " << dateString(d.first);
+        for (const auto& item : report->second.itemCounts)
+            out << " " << item.first.first << " " << item.first.second << " " << item.second;
+        out << "\n";
     }
+    out << "BEGIN\n";
+}
 
-    // Inventory
-    {
-        ifstream invFile(FILE_INVENTORY);
-        if (invFile) {
-            Product p;
-            while (invFile >> p.id) {
-                invFile.ignore();
-                getline(invFile, p.name);
-                invFile >> p.price;
-                invFile >> p.stock;
-                inventory.push_back(p);
+// reportFigures also reads the highest bills and item counts into reportDays;
+// startup skips them, only full reports need them
+static bool readSegmentHeader(istream& in, BookingSegment& s, bool reportFigures = false) {
+    string line, tag;
+    bool sawIds = false, sawService = false;
+    while (getline(in, line)) {
+        if (!reportFigures && line.compare(0, 6, "ITEMS ") == 0) continue;
+        istringstream ls(line);
+        ls >> tag;
+        if (tag == "BEGIN") return sawIds && sawService;
+        if (tag == "SEGMENT") continue;
+        if (tag == "COUNT") ls >> s.count;
+        else if (tag == "IDS") sawIds = (bool)(ls >> s.firstId >> s.lastId);
+        else if (tag == "SERVICE") {
+            string date;
+            sawService = (ls >> date) && parseDate(date, s.lastServiceDay);
+        }
+        else if (tag == "DAY") {
+            string date;
+            DayNum day;
+            SalesTotals t;
+            if (!(ls >> date) || !parseDate(date, day) || !(ls >> t.transactions) || !readMoney(ls, t.salesCents)) return false;
+            for (int k = 0; k < ITEM_KIND_COUNT; k++)
+                if (!readMoney(ls, t.kindCents[k])) return false;
+            s.days[day] = t;
+            Cents highest;
+            if (!readMoney(ls, highest)) {
+                ls.clear();
+                s.summarized = false;
+            }
+            else if (reportFigures) {
+                SalesAggregate& a = s.reportDays[day];
+                a.totalTransactions = (int)t.transactions;
+                a.salesCents = t.salesCents;
+                a.bills.insert(highest);
             }
         }
-        else {
-            loadDefaultsInventory();
+        else if (tag == "ITEMS") {
+            string date;
+            DayNum day;
+            if (!(ls >> date) || !parseDate(date, day)) return false;
+            SalesAggregate& a = s.reportDays[day];
+            int kind, ref, qty;
+            while (ls >> kind) {
+                if (!(ls >> ref >> qty)) return false;
+                a.itemCounts[{ kind, ref }] = qty;
+            }
+            ls.clear();
         }
+        else return false;
+        if (!ls) return false;
     }
+    return false;
+}
 
-    // Bookings
-    {
-        ifstream bookFile(FILE_BOOKINGS);
-        if (bookFile) {
+// "yyyy-mm.txt" -> month index
+static bool segmentFileMonth(const string& fileName, int& month) {
+    return fileName.size() == 11 && fileName.compare(7, 4, ".txt") == 0 && parseMonth(fileName.substr(0, 7), month);
+}
+
+// Reads every segment header and the records of hot segments into
+// allBookings. Months in loadedMonths (the snapshot's) or already present in
+// allBookings (an import) count as loaded and are not read again.
+void loadBookingSegments(const vector<int>& loadedMonths) {
+    namespace fs = std::filesystem;
+    bookingSegments.clear();
+    set<int> loaded(loadedMonths.begin(), loadedMonths.end());
+    for (const auto& b : allBookings) loaded.insert(monthIndexOf(b.day));
+
+    error_code ec;
+    for (const auto& entry : fs::directory_iterator(DIR_BOOKING_SEGMENTS, ec)) {
+        int month;
+        if (!segmentFileMonth(entry.path().filename().string(), month)) continue;
+        ifstream in(entry.path());
+        BookingSegment s;
+        bool headerOk = readSegmentHeader(in, s);
+        if (headerOk && s.lastId >= nextBookingID) nextBookingID = s.lastId + 1;
+
+        if (loaded.count(month)) s.loaded = true;
+        else if (!headerOk || segmentIsHot(month, s)) {
+            // Hot, or a header we cannot trust: read the records now
+            if (!headerOk) {
+                in.clear();
+                in.seekg(0);
+                string line;
+                while (getline(in, line) && line != "BEGIN") {}
+            }
             BookingRecord b;
-            int itemCount;
-            while (bookFile >> b.bookingID) {
-                bookFile.ignore();
-                getline(bookFile, b.customerName);
-                getline(bookFile, b.customerPhone);
-                getline(bookFile, b.dateStr);
-                bookFile >> b.totalAmount;
-                bookFile >> itemCount;
-                bookFile.ignore();
-
-                b.items.clear();
-                for (int i = 0; i < itemCount; i++) {
-                    string itemLine;
-                    getline(bookFile, itemLine);
-                    b.items.push_back(itemLine);
-                }
+            while (readBookingRecord(in, b)) {
                 allBookings.push_back(b);
-
-                if (b.bookingID >= nextBookingID)
-                    nextBookingID = b.bookingID + 1;
+                if (b.bookingID >= nextBookingID) nextBookingID = b.bookingID + 1;
             }
+            s.loaded = true;
         }
-    }
-
-    // Feedback
-    {
-        ifstream feedFile(FILE_FEEDBACKS);
-        if (feedFile) {
-            string line;
-            while (getline(feedFile, line)) {
-                line = trimCopy(line);
-                if (!line.empty()) feedbackList.push_back(line);
-            }
+        if (s.loaded) {
+            s.days.clear();
+            s.reportDays.clear();
         }
+        bookingSegments[month] = move(s);
     }
+    for (int month : loadedMonths) bookingSegments[month].loaded = true;
 }
 
-void saveData() {
-    {
-        ofstream memberFile(FILE_MEMBERS);
-        for (const auto& m : members) {
-            memberFile << m.name << "\n" << m.phone << "\n" << m.type << "\n"
-                << m.joinDate << "\n" << m.expiryDate << "\n";
-        }
+// Reads a segment file whole. False if the header is bad or it holds fewer
+// records than the header counts (a damaged file).
+static bool readSegmentFile(int month, vector<BookingRecord>& records) {
+    ifstream in(segmentPath(month));
+    BookingSegment header;
+    if (!readSegmentHeader(in, header)) return false;
+    records.reserve((size_t)max(0, header.count));
+    BookingRecord b;
+    while (readBookingRecord(in, b)) records.push_back(b);
+    return (int)records.size() == header.count;
+}
+
+// Brings an unloaded month into memory through appendBooking, swapping its
+// header figures in the range index and the report aggregates for the real
+// records. False if the file
+// could not be read; the segment then stays unloaded, with its totals.
+bool loadSegment(int month) {
+    auto found = bookingSegments.find(month);
+    if (found == bookingSegments.end() || found->second.loaded) return true;
+    ScopedTimer timer(Metric::SegmentLoad);
+    vector<BookingRecord> records;
+    if (!readSegmentFile(month, records)) {
+        cout << "[System] ERROR: cannot read " << segmentPath(month) << "\n";
+        found->second.unreadable = true;
+        return false;
     }
-    {
-        ofstream invFile(FILE_INVENTORY);
-        for (const auto& item : inventory) {
-            invFile << item.id << "\n" << item.name << "\n" << item.price << "\n" << item.stock << "\n";
-        }
+
+    BookingSegment& s = found->second;
+    s.loaded = true;
+    s.unreadable = false;
+    for (const auto& d : s.days) addSalesDay(d.first, d.second, -1);
+    s.days.clear();
+    // Nothing else of this month is in the aggregates while it is cold
+    for (const auto& d : s.reportDays) dailyAgg.erase(d.first);
+    if (!s.reportDays.empty()) monthlyAgg.erase(month);
+    s.reportDays.clear();
+    // Older IDs than the slot table covers would make every lookup below a scan
+    int lowestId = INT_MAX;
+    for (const auto& b : records) lowestId = min(lowestId, b.bookingID);
+    if (lowestId < bookingIdBase) rebuildBookingSlots(lowestId);
+    bool dirty = s.dirty;
+    for (const auto& b : records) {
+        if (findLoadedBookingSlot(b.bookingID) >= 0) continue;
+        appendBooking(b);
     }
-    {
-        ofstream bookFile(FILE_BOOKINGS);
-        for (const auto& b : allBookings) {
-            bookFile << b.bookingID << "\n";
-            bookFile << b.customerName << "\n";
-            bookFile << b.customerPhone << "\n";
-            bookFile << b.dateStr << "\n";
-            bookFile << b.totalAmount << "\n";
-            bookFile << b.items.size() << "\n";
-            for (const auto& it : b.items) bookFile << it << "\n";
+    s.dirty = dirty;
+    counters.segmentsLoaded++;
+    return true;
+}
+
+void ensureSegmentLoaded(DayNum day) {
+    if (day != NO_DATE) loadSegment(monthIndexOf(day));
+}
+
+// Every month at once (the full-history benchmarks): read the records in bulk
+// and rebuild the indexes once instead of indexing booking by booking.
+void loadAllBookingSegments() {
+    ScopedTimer timer(Metric::SegmentLoad);
+    bool any = false;
+    for (auto& kv : bookingSegments) {
+        BookingSegment& s = kv.second;
+        if (s.loaded) continue;
+        vector<BookingRecord> records;
+        if (!readSegmentFile(kv.first, records)) {
+            cout << "[System] ERROR: cannot read " << segmentPath(kv.first) << "\n";
+            s.unreadable = true;
+            continue; // stays unloaded; its header totals remain in the index
         }
+        s.loaded = true;
+        s.unreadable = false;
+        s.days.clear();
+        s.reportDays.clear();
+        allBookings.insert(allBookings.end(), records.begin(), records.end());
+        counters.segmentsLoaded++;
+        any = true;
     }
-    {
-        ofstream feedFile(FILE_FEEDBACKS);
-        for (const auto& f : feedbackList) feedFile << f << "\n";
+    if (any) rebuildBookingIndexes();
+}
+
+bool loadSegmentsHolding(int bookingID) {
+    bool any = false;
+    for (auto& kv : bookingSegments) {
+        const BookingSegment& s = kv.second;
+        if (s.loaded || bookingID < s.firstId || bookingID > s.lastId) continue;
+        loadSegment(kv.first);
+        any = true;
     }
+    return any;
+}
 
-    cout << "[System] All data saved successfully.\n";
+void noteSegmentSale(const BookingRecord& b) {
+    int month = monthIndexOf(b.day);
+    // An older file for this month must not be overwritten: if it cannot be
+    // read, the segment stays clean and unloaded, and saveBookingSegments
+    // keeps the journal instead of writing the month from memory.
+    if (!loadSegment(month)) return;
+    BookingSegment& s = bookingSegments[month];
+    s.loaded = true;
+    s.dirty = true;
+    addToSegment(s, b);
 }
 
-// ================= REPORT HELPERS =================
-string getBestItem(const map<string, int>& counts) {
-    string best = "-";
-    int mx = 0;
-    for (const auto& kv : counts) {
-        if (kv.second > mx) {
-            mx = kv.second;
-            best = kv.first + " (" + to_string(kv.second) + " sold)";
+void noteSegmentCancel(const BookingRecord& b) {
+    bookingSegments[monthIndexOf(b.day)].dirty = true;
+}
+
+// Months that reached allBookings without a segment load (an import, a fresh
+// history) are loaded by definition and still need writing.
+void registerLoadedSegments() {
+    for (const auto& b : allBookings) {
+        BookingSegment& s = bookingSegments[monthIndexOf(b.day)];
+        if (s.unreadable) continue; // sales into it wait in the journal
+        if (!s.loaded) {
+            s.loaded = true;
+            s.dirty = true;
+            s.days.clear();
+            s.reportDays.clear();
         }
+        s.lastServiceDay = max(s.lastServiceDay, lastServiceDayOf(b));
     }
-    return best;
 }
 
-// Parse cart item into category + name + qty
-static inline void categorizeItem(const string& item, string& cat, string& name, int& qty) {
-    cat = "Other";
-    name = item;
-    qty = 1;
+// A cold day is all in its header, so it takes the day's aggregate whole;
+// its month sums the days
+static void addColdReportFigures(int month, const BookingSegment& s) {
+    for (const auto& d : s.reportDays) {
+        const SalesAggregate& day = d.second;
+        dailyAgg[d.first] = day;
+        SalesAggregate& m = monthlyAgg[month];
+        m.totalTransactions += day.totalTransactions;
+        m.salesCents += day.salesCents;
+        m.bills.insert(day.bills.begin(), day.bills.end());
+        for (const auto& item : day.itemCounts) m.itemCounts[item.first] += item.second;
+    }
+}
 
-    // Skip locker from "best" stats, but keep in bill/sales by default
-    if (startsWith(item, "Locker:") || item.find("Locker") != string::npos) {
-        cat = "Locker";
-        name = trimCopy(item);
-        qty = 1;
-        return;
+// Header figures of the unloaded months
+void addColdSegmentTotals() {
+    for (const auto& kv : bookingSegments) {
+        for (const auto& d : kv.second.days) addSalesDay(d.first, d.second, +1);
+        addColdReportFigures(kv.first, kv.second);
     }
+}
 
-    if (startsWith(item, "Booking:")) {
-        cat = "Booking";
-        // Booking: Name [date ...]
-        size_t start = string("Booking:").size();
-        while (start < item.size() && item[start] == ' ') start++;
-        size_t end = item.find("[");
-        if (end != string::npos && end > start) name = trimCopy(item.substr(start, end - start));
-        else name = trimCopy(item.substr(start));
-        qty = 1;
-        return;
+// Full reports cover cold months from their header figures, read here on
+// first use. Only files from before headers carried them need their records,
+// once: they stay dirty, so the next save rewrites them with a full header.
+void loadColdReportFigures() {
+    vector<int> older;
+    for (auto& kv : bookingSegments) {
+        BookingSegment& s = kv.second;
+        if (s.loaded || !s.reportDays.empty()) continue;
+        if (!s.summarized) { older.push_back(kv.first); continue; }
+        ifstream in(segmentPath(kv.first));
+        BookingSegment header;
+        if (!readSegmentHeader(in, header, true) || !header.summarized) { older.push_back(kv.first); continue; }
+        s.reportDays = move(header.reportDays);
+        addColdReportFigures(kv.first, s);
     }
+    for (int month : older)
+        if (loadSegment(month)) bookingSegments[month].dirty = true;
+}
 
-    if (startsWith(item, "Rent:")) {
-        cat = "Rent";
-        name = trimCopy(item.substr(string("Rent:").size()));
-        qty = 1;
-        return;
+// Rewrites the segments that changed, each atomically, adding to bytes.
+// False if any could not be written (it stays dirty).
+bool saveBookingSegments(uint64_t& bytes) {
+    namespace fs = std::filesystem;
+    map<int, vector<const BookingRecord*>> byMonth;
+    bool ok = true;
+    for (const auto& b : allBookings) {
+        if (b.cancelled) continue;
+        int month = monthIndexOf(b.day);
+        const BookingSegment& s = bookingSegments[month];
+        if (s.dirty) byMonth[month].push_back(&b);
+        else if (!s.loaded) ok = false; // sold into a month whose file is unreadable
     }
 
-    if (startsWith(item, "Buy:")) {
-        cat = "Product";
-        // Buy: X x N
-        string rest = trimCopy(item.substr(string("Buy:").size()));
-        size_t pos = rest.find(" x ");
-        if (pos != string::npos) {
-            name = trimCopy(rest.substr(0, pos));
-            try { qty = stoi(trimCopy(rest.substr(pos + 3))); }
-            catch (...) { qty = 1; }
+    error_code ec;
+    fs::create_directories(DIR_BOOKING_SEGMENTS, ec);
+    for (auto& kv : bookingSegments) {
+        BookingSegment& s = kv.second;
+        if (!s.dirty) continue;
+        const vector<const BookingRecord*>& records = byMonth[kv.first];
+        if (records.empty()) {
+            fs::remove(segmentPath(kv.first), ec);
+            syncDirOf(segmentPath(kv.first));
+            s.dirty = false;
+            continue;
         }
-        else {
-            name = rest;
-            qty = 1;
+
+        BookingSegment header;
+        for (const BookingRecord* b : records) {
+            addToSegment(header, *b);
+            if (b->day == NO_DATE) continue;
+            header.days[b->day].add(salesTotalsOf(*b), +1);
+            applyToAggregate(header.reportDays, b->day, *b, +1);
         }
-        return;
+        int64_t written = writeFileAtomic(segmentPath(kv.first), [&](ostream& out) {
+            writeSegmentHeader(out, kv.first, header);
+            for (const BookingRecord* b : records) writeBookingRecord(out, *b);
+        });
+        if (written < 0) { ok = false; continue; }
+        bytes += (uint64_t)written;
+        s.dirty = false;
+        s.count = header.count;
+        s.firstId = header.firstId;
+        s.lastId = header.lastId;
+        s.lastServiceDay = header.lastServiceDay;
     }
+    // Its bookings are all in segments now
+    if (ok && fs::remove(FILE_BOOKINGS, ec)) syncDirOf(FILE_BOOKINGS);
+    return ok;
+}
+
+// Months whose bookings go into the snapshot
+vector<int> hotSegmentMonths() {
+    vector<int> months;
+    for (const auto& kv : bookingSegments)
+        if (kv.second.loaded && segmentIsHot(kv.first, kv.second)) months.push_back(kv.first);
+    return months;
 }
 
 void generateDailyReports() {
+    ScopedTimer timer(Metric::ReportBuild);
     dailyReports.clear();
 
-    map<string, map<string, map<string, int>>> tracker; // date->cat->name->count
-    map<string, double> sales;
-    map<string, int> txns;
-
-    for (const auto& b : allBookings) {
-        if (b.dateStr.size() < 10) continue;
-        string date = b.dateStr.substr(0, 10); // DD/MM/YYYY
-
-        sales[date] += b.totalAmount;
-        txns[date]++;
-
-        for (const string& item : b.items) {
-            string cat, name;
-            int qty = 1;
-            categorizeItem(item, cat, name, qty);
-
-            // For "best" stats, ignore lockers
-            if (cat == "Locker") continue;
-
-            tracker[date][cat][name] += max(1, qty);
-        }
-    }
-
-    for (const auto& kv : tracker) {
+    for (const auto& kv : dailyAgg) {
         DailyReport r;
         r.date = kv.first;
-        r.totalSales = sales[r.date];
-        r.totalTransactions = txns[r.date];
-        r.bestBooking = getBestItem(tracker[r.date]["Booking"]);
-        r.bestRental = getBestItem(tracker[r.date]["Rent"]);
-        r.bestProduct = getBestItem(tracker[r.date]["Product"]);
+        r.salesCents = kv.second.salesCents;
+        r.totalTransactions = kv.second.totalTransactions;
+        r.bestBooking = getBestItem(kv.second, ItemKind::Booking);
+        r.bestRental = getBestItem(kv.second, ItemKind::Rental);
+        r.bestProduct = getBestItem(kv.second, ItemKind::Product);
         dailyReports.push_back(r);
     }
-
-    // Sort by date string (DD/MM/YYYY) lexicographic isn't perfect across months;
-    // keep insertion order ok. If you want exact sorting, we can convert to y-m-d.
+    // dailyAgg is keyed by day number, so reports come out in calendar order
 }
 
 void generateMonthlyReports() {
+    ScopedTimer timer(Metric::ReportBuild);
     monthlyReports.clear();
 
-    map<string, map<string, map<string, int>>> tracker; // month->cat->name->count
-    map<string, double> sales;
-    map<string, int> txns;
-    map<string, double> highestBill;
-
-    for (const auto& b : allBookings) {
-        if (b.dateStr.size() < 10) continue;
-
-        // "DD/MM/YYYY ..."
-        string monthKey = b.dateStr.substr(6, 4) + "-" + b.dateStr.substr(3, 2); // YYYY-MM
-
-        sales[monthKey] += b.totalAmount;
-        txns[monthKey]++;
-        highestBill[monthKey] = max(highestBill[monthKey], b.totalAmount);
-
-        for (const string& item : b.items) {
-            string cat, name;
-            int qty = 1;
-            categorizeItem(item, cat, name, qty);
-
-            if (cat == "Locker") continue; // ignore in best stats
-            tracker[monthKey][cat][name] += max(1, qty);
-        }
-    }
-
-    for (const auto& kv : tracker) {
+    for (const auto& kv : monthlyAgg) {
         MonthlyReport r;
         r.month = kv.first;
-        r.totalSales = sales[r.month];
-        r.totalTransactions = txns[r.month];
-        r.highestIncome = highestBill[r.month];
-        r.bestBooking = getBestItem(tracker[r.month]["Booking"]);
-        r.bestRental = getBestItem(tracker[r.month]["Rent"]);
-        r.bestProduct = getBestItem(tracker[r.month]["Product"]);
+        r.salesCents = kv.second.salesCents;
+        r.totalTransactions = kv.second.totalTransactions;
+        r.highestBillCents = kv.second.bills.empty() ? 0 : *kv.second.bills.rbegin();
+        r.bestBooking = getBestItem(kv.second, ItemKind::Booking);
+        r.bestRental = getBestItem(kv.second, ItemKind::Rental);
+        r.bestProduct = getBestItem(kv.second, ItemKind::Product);
         monthlyReports.push_back(r);
     }
 }
@@ -578,9 +3546,9 @@ void checkDailyReport() {
 
     for (const auto& r : dailyReports) {
         cout << "========================================\n";
-        cout << "DATE: " << r.date << "\n";
+        cout << "DATE: " << dateString(r.date) << "\n";
         cout << "Transactions: " << r.totalTransactions << "\n";
-        cout << "Total Sales : RM " << fixed << setprecision(2) << r.totalSales << "\n";
+        cout << "Total Sales : RM " << moneyString(r.salesCents) << "\n";
         cout << "----------------------------------------\n";
         cout << "Top Booking : " << r.bestBooking << "\n";
         cout << "Top Rental  : " << r.bestRental << "\n";
@@ -595,10 +3563,10 @@ void checkMonthlyReport() {
 
     for (const auto& r : monthlyReports) {
         cout << "========================================\n";
-        cout << "MONTH: " << r.month << "\n";
+        cout << "MONTH: " << monthString(r.month) << "\n";
         cout << "Transactions: " << r.totalTransactions << "\n";
-        cout << "Total Sales : RM " << fixed << setprecision(2) << r.totalSales << "\n";
-        cout << "Highest Bill: RM " << fixed << setprecision(2) << r.highestIncome << "\n";
+        cout << "Total Sales : RM " << moneyString(r.salesCents) << "\n";
+        cout << "Highest Bill: RM " << moneyString(r.highestBillCents) << "\n";
         cout << "----------------------------------------\n";
         cout << "Top Booking : " << r.bestBooking << "\n";
         cout << "Top Rental  : " << r.bestRental << "\n";
@@ -607,6 +3575,46 @@ void checkMonthlyReport() {
     }
 }
 
+// Sales for an inclusive date range next to the same number of days just
+// before it (7 days -> week over week).
+void printSalesRange(DayNum from, DayNum to) {
+    int days = to - from + 1;
+    SalesTotals t = salesBetween(from, to);
+    SalesTotals prev = salesBetween(from - days, from - 1);
+
+    cout << "========================================\n";
+    cout << "RANGE: " << dateString(from) << " - " << dateString(to) << " (" << days << " days)\n";
+    cout << "Transactions: " << t.transactions << "  (previous " << days << " days: " << prev.transactions << ")\n";
+    cout << "Total Sales : RM " << moneyString(t.salesCents) << "  (previous: RM " << moneyString(prev.salesCents) << ")\n";
+    cout << "----------------------------------------\n";
+    cout << "By category (before discounts and tax):\n";
+    for (int k = 0; k < ITEM_KIND_COUNT; k++) {
+        if (t.kindCents[k] == 0) continue;
+        cout << "  " << left << setw(10) << ITEM_KIND_NAMES[k] << ": RM " << moneyString(t.kindCents[k]) << "\n";
+    }
+    cout << "========================================\n\n";
+}
+
+const size_t TOP_SELLERS_SHOWN = 10;
+
+// Top sellers per category for one day or month. Returns false if nothing sold.
+bool printTopSellers(const SalesAggregate* a, const string& title) {
+    if (!a || a->totalTransactions == 0) return false;
+    const ItemKind kinds[] = { ItemKind::Booking, ItemKind::Rental, ItemKind::Product };
+    cout << "========================================\n";
+    cout << "TOP SELLERS: " << title << "\n";
+    for (ItemKind kind : kinds) {
+        cout << "----------------------------------------\n";
+        cout << ITEM_KIND_NAMES[(int)kind] << ":\n";
+        vector<TopSeller> top = topSellers(*a, kind, TOP_SELLERS_SHOWN);
+        if (top.empty()) cout << "  -\n";
+        for (size_t i = 0; i < top.size(); i++)
+            cout << "  " << setw(2) << right << i + 1 << ". " << sellerString(top[i]) << "\n";
+    }
+    cout << "========================================\n\n";
+    return true;
+}
+
 // ================= UI / MODULES =================
 void displayIntro() {
     cout << "\n\n";
@@ -675,13 +3683,19 @@ void applyMembership() {
             continue;
         }
 
+        // Phone is the member ID -> must be unique
+        if (findMemberSlot(phone) >= 0) {
+            cout << "Phone already registered. Restarting from NAME...\n";
+            continue;
+        }
+
         // ============ JOIN DATE (AUTO) ============
-        string joinDate = getCurrentTimestamp(false);
-        cout << "Start Date: " << joinDate << " (Auto)\n";
+        DayNum joinDate = today();
+        cout << "Start Date: " << dateString(joinDate) << " (Auto)\n";
 
         // ============ PLAN ============
         string choice, type;
-        double price = 0.0;
+        Cents fee = 0;
         int durationMonths = 0;
 
         cout << "\n-- Membership Plan --\n";
@@ -692,19 +3706,19 @@ void applyMembership() {
         choice = trimCopy(choice);
 
         // Any invalid plan -> go back to NAME
-        if (choice == "1") { price = 60.0; type = "6 Months"; durationMonths = 6; }
-        else if (choice == "2") { price = 100.0; type = "12 Months"; durationMonths = 12; }
+        if (choice == "1") { fee = 6000; type = "6 Months"; durationMonths = 6; }
+        else if (choice == "2") { fee = 10000; type = "12 Months"; durationMonths = 12; }
         else {
             cout << "Invalid option. Restarting from NAME...\n";
             continue;
         }
 
-        string expiry = calculateExpiry(joinDate, durationMonths);
+        DayNum expiry = addMonths(joinDate, durationMonths);
 
         cout << "\n----------------------------\n";
-        cout << left << setw(15) << "Fee" << ": RM " << fixed << setprecision(2) << price << "\n";
+        cout << left << setw(15) << "Fee" << ": RM " << moneyString(fee) << "\n";
         cout << left << setw(15) << "Duration" << ": " << durationMonths << " Months\n";
-        cout << left << setw(15) << "Valid Until" << ": " << expiry << "\n";
+        cout << left << setw(15) << "Valid Until" << ": " << dateString(expiry) << "\n";
         cout << "----------------------------\n";
 
         // ============ PAYMENT ============
@@ -719,14 +3733,23 @@ void applyMembership() {
         }
 
         // ============ SAVE ============
-        members.push_back({ name, phone, type, joinDate, expiry });
+        Member m{ name, phone, type, joinDate, expiry };
+        if (!addMember(m)) {
+            cout << "Phone already registered. Restarting from NAME...\n";
+            continue;
+        }
 
-        saveData();
+        journalMemberAdd(m);
+        if (!journalSync()) {
+            removeMember(phone);
+            cout << "Membership could not be saved to disk. No fee charged; please try again later.\n";
+            return;
+        }
 
         cout << "\n=========================================\n";
         cout << "   MEMBERSHIP REGISTERED SUCCESSFULLY!   \n";
         cout << "   Welcome, " << name << "!\n";
-        cout << "   Valid Until: " << expiry << "\n";
+        cout << "   Valid Until: " << dateString(expiry) << "\n";
         cout << "=========================================\n";
         return;
     }
@@ -739,84 +3762,401 @@ void facilityInfo() {
     cout << "Badminton\tRM   15\t\tRM   20\n";
     cout << "Pickleball\tRM   15\t\tRM   20\n";
     cout << "Basketball\tRM   40\t\tRM   50\n";
+    cout << "Courts:";
+    for (int f = 0; f < FACILITY_COUNT; f++)
+        if (FACILITIES[f].hourly) cout << (f ? ", " : " ") << FACILITIES[f].name << " x" << FACILITIES[f].courts;
+    cout << "\n";
 
     cout << "\n-- Per Entry Prices --\n";
     cout << "Sport:\t\t\t\tWeekday\t\tWeekend\n";
     cout << "Swimming Pool\t\t\tRM    5\t\tRM    8\n";
     cout << "Gym Room\t\t\tRM   10\t\tRM   10\n";
-    cout << "Fitness Studio (Max 10 peope)\tRM   30\t\tRM   30\n";
+    cout << "Fitness Studio\t\t\tRM   30\t\tRM   30\n";
+    cout << "Sessions: " << ENTRY_SESSION_MINUTES / 60 << " hours each from " << slotHHMM(OPEN_MINUTE) << ". Max per session:";
+    const char* sep = " ";
+    for (int f = 0; f < FACILITY_COUNT; f++) {
+        if (FACILITIES[f].capacity <= 0) continue;
+        cout << sep << FACILITIES[f].name << " " << FACILITIES[f].capacity;
+        sep = ", ";
+    }
+    cout << "\n";
+}
+
+bool isTodayOrTomorrow(DayNum day) {
+    DayNum t = today();
+    return day == t || day == t + 1;
 }
 
-bool isTodayOrTomorrow(int d, int m, int y) {
-    time_t now = time(nullptr);
-    tm t{};
-#ifdef _WIN32
-    localtime_s(&t, &now);
-#else
-    localtime_r(&now, &t);
-#endif
-    t.tm_hour = 0; t.tm_min = 0; t.tm_sec = 0;
-    time_t today = mktime(&t);
 
-    tm target{};
-    target.tm_year = y - 1900;
-    target.tm_mon = m - 1;
-    target.tm_mday = d;
-    target.tm_hour = 0; target.tm_min = 0; target.tm_sec = 0;
-    time_t tt = mktime(&target);
 
-    double diffDays = difftime(tt, today) / 86400.0;
-    return (diffDays >= 0.0 && diffDays <= 1.0);
+// ================= POS OPERATIONS =================
+// The business rules behind the menus, without any cin/cout, so the same code
+// runs at the counter and from a headless replay script.
+
+enum class SlotCheck { Ok, BadFormat, OutsideHours, EndBeforeStart, TooShort, AlreadyPassed, Clash, Full };
+
+// Cells of a day that can no longer be sold: all of a past day, and the ones
+// that have already started today (checkCourtSlot rejects those)
+static uint64_t passedCells(DayNum date) {
+    DayNum nowDay;
+    int nowMinute;
+    nowDayMinute(nowDay, nowMinute);
+    if (date < nowDay) return GRID_FULL;
+    return date == nowDay ? gridMask(OPEN_MINUTE, nowMinute + 1) : 0;
 }
 
-string getDateOffsetStr(int offsetDays) {
-    time_t now = time(nullptr);
-    tm t{};
-#ifdef _WIN32
-    localtime_s(&t, &now);
-#else
-    t = *localtime(&now);
-#endif
-    t.tm_hour = 0; t.tm_min = 0; t.tm_sec = 0;
+// Validates the slot and picks a court for it (best fit, see pickCourt).
+// Courts this lane's cart already holds at that time count as taken.
+SlotCheck checkCourtSlot(int facilityId, DayNum date, int startHHMM, int endHHMM, int& court) {
+    if (!isValidHHMM(startHHMM) || !isValidHHMM(endHHMM)) return SlotCheck::BadFormat;
+
+    int startMin = toMinutes(startHHMM);
+    int endMin = toMinutes(endHHMM);
 
-    time_t base = mktime(&t);
-    base += (time_t)offsetDays * 86400;
+    // Operating hours: 10:00 to 22:00
+    if (startMin < OPEN_MINUTE || endMin > CLOSE_MINUTE) return SlotCheck::OutsideHours;
+    if (endMin <= startMin) return SlotCheck::EndBeforeStart;
+    if (endMin - startMin < MIN_COURT_MINUTES) return SlotCheck::TooShort;
+
+    // Booking for TODAY whose start time already passed
+    DayNum nowDay;
+    int nowMinute;
+    nowDayMinute(nowDay, nowMinute);
+    if (date == nowDay && startMin <= nowMinute) return SlotCheck::AlreadyPassed;
+
+    // Timed here, per slot asked for, rather than in the per-court lookups
+    ScopedTimer timer(Metric::ClashCheck);
+    lock_guard<mutex> lock(storeMutex);
+    const vector<LineItem>& cart = currentSession->cartItems;
+    court = pickCourt(facilityId, date, startMin, endMin, cart.data(), cart.size());
+    return court < 0 ? SlotCheck::Clash : SlotCheck::Ok;
+}
 
-#ifdef _WIN32
-    localtime_s(&t, &base);
-#else
-    t = *localtime(&base);
-#endif
+// After a Clash: the nearest bookable slots of the same length on any court
+vector<CourtSlot> suggestCourtSlots(int facilityId, DayNum date, int startHHMM, int endHHMM, size_t maxCount = 3) {
+    uint64_t passed = passedCells(date);
+    lock_guard<mutex> lock(storeMutex);
+    const vector<LineItem>& cart = currentSession->cartItems;
+    return nearestCourtSlots(facilityId, date, toMinutes(startHHMM), toMinutes(endHHMM), passed, maxCount,
+        cart.data(), cart.size());
+}
+
+struct CourtAvailability {
+    int facilityId;
+    int court;
+    uint64_t busy;               // grid cells that cannot be booked
+    vector<pair<int, int>> free; // stretches of at least the asked length, [startMin, endMin)
+};
 
-    char buf[16];
-    strftime(buf, sizeof(buf), "%d/%m/%Y", &t);
-    return string(buf);
+// Free stretches of at least minMinutes on every court of every hourly
+// facility for one day; cells that have already started count as taken.
+vector<CourtAvailability> findFreeCourtSlots(DayNum date, int minMinutes) {
+    uint64_t passed = passedCells(date);
+    vector<CourtAvailability> out;
+    lock_guard<mutex> lock(storeMutex);
+    for (int f = 0; f < FACILITY_COUNT; f++) {
+        for (int c = 0; c < FACILITIES[f].courts; c++) {
+            uint64_t busy = courtBusyCells(f, c, date) | passed;
+            out.push_back({ f, c, busy, freeRuns(busy, minMinutes) });
+        }
+    }
+    return out;
 }
 
-bool isWeekendDate(const string& ddmmyyyy) {
-    int d, m, y;
-    if (!parseDateDDMMYYYY(ddmmyyyy, d, m, y)) return false;
+LineItem makeCourtItem(int facilityId, int court, DayNum date, int startHHMM, int endHHMM) {
+    LineItem item;
+    item.kind = ItemKind::Booking;
+    item.refId = facilityId;
+    item.court = (int16_t)court;
+    item.date = date;
+    item.slotStart = (int16_t)toMinutes(startHHMM);
+    item.slotEnd = (int16_t)toMinutes(endHHMM);
+    item.unitCents = courtPriceCents(facilityId, isWeekend(date), item.slotEnd - item.slotStart); // 90 mins = 1.5h
+    return item;
+}
 
-    tm t{};
-    t.tm_year = y - 1900;
-    t.tm_mon = m - 1;
-    t.tm_mday = d;
-    t.tm_hour = 12; // safer for DST
+// People in this lane's cart for one entry session
+static int cartEntryPeople(int facilityId, DayNum date, int session) {
+    int people = 0;
+    for (const auto& it : currentSession->cartItems)
+        if (it.refId == facilityId && it.date == date && entrySessionOf(it) == session) people += it.qty;
+    return people;
+}
 
-    time_t tt = mktime(&t);
-    if (tt == -1) return false;
+// Whether one more pass fits the session: sold passes plus this lane's cart
+// must stay within the facility's capacity. Sessions that have ended are closed.
+SlotCheck checkEntrySession(int facilityId, DayNum date, int session) {
+    if (session < 0 || session >= ENTRY_SESSIONS) return SlotCheck::BadFormat;
+    DayNum nowDay;
+    int nowMinute;
+    nowDayMinute(nowDay, nowMinute);
+    int sessionEnd = OPEN_MINUTE + (session + 1) * ENTRY_SESSION_MINUTES;
+    if (date < nowDay || (date == nowDay && sessionEnd <= nowMinute)) return SlotCheck::AlreadyPassed;
+
+    int capacity = FACILITIES[facilityId].capacity;
+    if (capacity <= 0) return SlotCheck::Ok;
+    lock_guard<mutex> lock(storeMutex);
+    int people = entryOccupancyOf(facilityId, date, session) + cartEntryPeople(facilityId, date, session);
+    return people < capacity ? SlotCheck::Ok : SlotCheck::Full;
+}
 
-    tm out{};
-#ifdef _WIN32
-    localtime_s(&out, &tt);
-#else
-    localtime_r(&tt, &out);
-#endif
+// First session of the day that has not ended yet (ENTRY_SESSIONS if none)
+int nextEntrySession(DayNum date) {
+    DayNum nowDay;
+    int nowMinute;
+    nowDayMinute(nowDay, nowMinute);
+    if (date != nowDay) return date < nowDay ? ENTRY_SESSIONS : 0;
+    int session = 0;
+    while (session < ENTRY_SESSIONS && OPEN_MINUTE + (session + 1) * ENTRY_SESSION_MINUTES <= nowMinute) session++;
+    return session;
+}
+
+LineItem makeEntryItem(int facilityId, DayNum date, int session) {
+    LineItem item;
+    item.kind = ItemKind::Booking;
+    item.refId = facilityId;
+    item.date = date;
+    item.slotStart = (int16_t)(OPEN_MINUTE + session * ENTRY_SESSION_MINUTES);
+    item.slotEnd = (int16_t)(item.slotStart + ENTRY_SESSION_MINUTES);
+    item.unitCents = entryPriceCents(facilityId, isWeekend(date));
+    return item;
+}
+
+LineItem makeRentalItem(int rentalId, int qty) {
+    LineItem item;
+    item.kind = ItemKind::Rental;
+    item.refId = rentalId;
+    item.qty = qty;
+    item.unitCents = RENTALS[rentalId].priceCents;
+    return item;
+}
+
+LineItem makeLockerItem(int lockerId) {
+    LineItem item;
+    item.kind = ItemKind::Locker;
+    item.refId = lockerId;
+    item.unitCents = LOCKERS[lockerId].priceCents;
+    return item;
+}
+
+enum class BuyResult { Ok, NotFound, OutOfStock, BadQuantity, NotEnoughStock };
+
+// Take stock and put the product in the cart. The stock check and the
+// decrement happen under one lock, so two lanes can never oversell.
+BuyResult buyProduct(int productId, int qty) {
+    LineItem item;
+    {
+        lock_guard<mutex> lock(storeMutex);
+        Product* p = findProduct(productId);
+        if (!p) return BuyResult::NotFound;
+        if (p->stock <= 0) return BuyResult::OutOfStock;
+        if (qty <= 0) return BuyResult::BadQuantity;
+        if (qty > p->stock) return BuyResult::NotEnoughStock;
+
+        p->stock -= qty;
+        journalStock(*p);
+
+        item.kind = ItemKind::Product;
+        item.refId = p->id;
+        item.qty = qty;
+        item.unitCents = p->priceCents;
+    }
+    addToCart(item, true);
+    return BuyResult::Ok;
+}
+
+struct Bill {
+    Cents subtotal = 0;
+    Cents promoDiscount = 0;
+    Cents memberDiscount = 0;
+    Cents tax = 0;
+    Cents grandTotal = 0;
+};
 
-    return (out.tm_wday == 0 || out.tm_wday == 6); // Sunday or Saturday
+// Promo first (never more than the subtotal), then 10% member discount, then
+// 6% SST, each rounded to the sen, so the printed lines add up to the total
+Bill computeBill(Cents subtotal, Cents promoDiscount, bool isMember) {
+    Bill bill;
+    bill.subtotal = subtotal;
+    bill.promoDiscount = min(promoDiscount, subtotal);
+
+    Cents afterMember = subtotal - bill.promoDiscount;
+    if (isMember) {
+        bill.memberDiscount = percentOf(afterMember, 10);
+        afterMember -= bill.memberDiscount;
+    }
+
+    bill.tax = percentOf(afterMember, 6);
+    bill.grandTotal = afterMember + bill.tax;
+    return bill;
+}
+
+// Next booking ID for this lane; refills from nextBookingID a block at a time
+int takeBookingID(PosSession& s) {
+    if (s.nextId >= s.idEnd) {
+        s.nextId = nextBookingID.fetch_add(BOOKING_ID_BLOCK);
+        s.idEnd = s.nextId + BOOKING_ID_BLOCK;
+    }
+    return s.nextId++;
+}
+
+// Keeps each court line on its court unless that court is now taken (or held
+// by an earlier line of the same cart), else moves it to the best free court
+// of the same facility. False if a line has nowhere to go. Caller holds storeMutex.
+static bool assignCourts(vector<LineItem>& items) {
+    for (size_t i = 0; i < items.size(); i++) {
+        LineItem& a = items[i];
+        if (!a.isCourt()) continue;
+        uint64_t cells = 0;
+        if (!hasCourtClash(a.refId, a.court, a.date, a.slotStart, a.slotEnd)
+            && !linesClash(items.data(), i, a.refId, a.court, a.date, a.slotStart, a.slotEnd, cells))
+            continue;
+
+        int court = pickCourt(a.refId, a.date, a.slotStart, a.slotEnd, items.data(), i);
+        if (court < 0) return false;
+        a.court = (int16_t)court;
+    }
+    return true;
+}
+
+// Entry passes in the cart plus those already sold must fit every session's
+// capacity. Caller holds storeMutex.
+static bool entriesFit(const vector<LineItem>& items) {
+    for (size_t i = 0; i < items.size(); i++) {
+        const LineItem& a = items[i];
+        int session = entrySessionOf(a);
+        int capacity = session < 0 ? 0 : FACILITIES[a.refId].capacity;
+        if (capacity <= 0) continue;
+
+        int people = entryOccupancyOf(a.refId, a.date, session);
+        for (const auto& o : items)
+            if (o.refId == a.refId && o.date == a.date && entrySessionOf(o) == session) people += o.qty;
+        if (people > capacity) return false;
+    }
+    return true;
+}
+
+enum class CheckoutResult { Ok, CourtTaken, SessionFull, NotSaved };
+
+// Turn the cart into a booking record and empty the cart. Court slots and
+// entry sessions were only checked when they went into the cart, so they are
+// checked again here under the lock: a line whose court another lane took
+// meanwhile moves to another free court at the same time. The sale only
+// stands once its journal record is on disk. On failure the cart is kept.
+CheckoutResult commitCheckout(const string& name, const string& phone, Cents grandTotal, BookingRecord& b) {
+    ScopedTimer timer(Metric::Checkout);
+    PosSession& session = *currentSession;
+    b = BookingRecord();
+    b.totalCents = grandTotal;
+    b.items = session.cartItems;
+    int minute;
+    nowDayMinute(b.day, minute);
+    b.minute = (int16_t)minute;
+    auto pc = make_shared<PendingCommit>();
+    {
+        lock_guard<mutex> lock(storeMutex);
+        if (!assignCourts(b.items)) return CheckoutResult::CourtTaken;
+        if (!entriesFit(b.items)) return CheckoutResult::SessionFull;
+        b.customerName = customerStrings.intern(name);
+        b.customerPhone = customerStrings.intern(phone);
+
+        b.bookingID = takeBookingID(session);
+        appendBooking(b);
+        pc->settle = [id = b.bookingID, items = b.items](bool durable) {
+            if (durable) {
+                counters.transactions++;
+                for (const auto& it : items) counters.itemsSold += (uint64_t)max(0, it.qty);
+                return;
+            }
+            // Never confirmed: void it. Its stock stays with the restored cart.
+            int slot = findBookingSlot(id);
+            if (slot >= 0) cancelBooking(slot);
+        };
+        journalSale(b, pc);
+    }
+
+    pc->cartItems = move(session.cartItems);
+    pc->cartCents = session.cartCents;
+    session.cartItems.clear();
+    session.cartCents = 0;
+    return finishCommit(session, pc) ? CheckoutResult::Ok : CheckoutResult::NotSaved;
+}
+
+// Put back merchandise/snack stock sold in a booking. The new levels are
+// journaled as STOCK records, so a replay never adds the same stock twice.
+void restockBookingItems(const BookingRecord& b) {
+    for (const auto& it : b.items) {
+        if (it.kind != ItemKind::Product || it.qty <= 0) continue;
+        if (Product* p = findProduct(it.refId)) {
+            p->stock += it.qty;
+            journalStock(*p);
+        }
+    }
+}
+
+enum class RefundResult { Ok, NotFound, NotSaved };
+
+// Cancel a booking, put its stock back and refund it. The REFUND record goes
+// to disk first and the booking is only cancelled once it is there, so the
+// court stays taken until the refund cannot be undone.
+RefundResult refundBooking(int bookingID) {
+    ScopedTimer timer(Metric::Refund);
+    auto pc = make_shared<PendingCommit>();
+    {
+        lock_guard<mutex> lock(storeMutex);
+        if (findBookingSlot(bookingID) < 0 || refundPending(bookingID)) return RefundResult::NotFound;
+        pc->refundId = bookingID;
+        pc->settle = [bookingID](bool durable) {
+            if (!durable) return;
+            int slot = findBookingSlot(bookingID);
+            if (slot < 0) return; // removed by the admin meanwhile
+            restockBookingItems(allBookings[slot]);
+            cancelBooking(slot);
+            counters.refunds++;
+        };
+        journalCancel(bookingID, true, pc);
+    }
+    return finishCommit(*currentSession, pc) ? RefundResult::Ok : RefundResult::NotSaved;
 }
 
+// Admin removal: like a refund, the REMOVE record goes to disk first and the
+// booking is only cancelled once it is there, but no stock goes back
+RefundResult removeBooking(int bookingID) {
+    auto pc = make_shared<PendingCommit>();
+    {
+        lock_guard<mutex> lock(storeMutex);
+        if (findBookingSlot(bookingID) < 0 || refundPending(bookingID)) return RefundResult::NotFound;
+        pc->refundId = bookingID;
+        pc->settle = [bookingID](bool durable) {
+            if (!durable) return;
+            int slot = findBookingSlot(bookingID);
+            if (slot >= 0) cancelBooking(slot);
+        };
+        journalCancel(bookingID, false, pc);
+    }
+    return finishCommit(*currentSession, pc) ? RefundResult::Ok : RefundResult::NotSaved;
+}
 
+// One row per court, one mark per 15 minutes, then the chosen court's free
+// stretches in the HHMM form the time prompts take
+void printCourtAvailability(DayNum date, int facilityId) {
+    vector<CourtAvailability> courts = findFreeCourtSlots(date, MIN_COURT_MINUTES);
+
+    cout << "\n-- " << FACILITIES[facilityId].name << " availability " << dateString(date) << " (# booked, . free) --\n";
+    cout << left << setw(10) << "";
+    for (int h = OPEN_MINUTE / 60; h < CLOSE_MINUTE / 60; h++) cout << left << setw(60 / GRID_STEP) << h;
+    cout << "\n";
+    for (const auto& c : courts) {
+        if (c.facilityId != facilityId) continue;
+        cout << left << setw(10) << ("Court " + to_string(c.court + 1));
+        for (int i = 0; i < GRID_CELLS; i++) cout << (((c.busy >> i) & 1) ? '#' : '.');
+        cout << "  ";
+        if (c.free.empty()) cout << "full";
+        for (size_t i = 0; i < c.free.size(); i++)
+            cout << (i ? " " : "") << slotHHMM(c.free[i].first) << "-" << slotHHMM(c.free[i].second);
+        cout << "\n";
+    }
+}
 
 void bookFacility() {
     cout << "\n-- Book Facility --\n";
@@ -826,14 +4166,13 @@ void bookFacility() {
 
     while (true) {
         // =============== DATE PICK (AUTO) ===============
-        string todayStr = getDateOffsetStr(0);
-        string tomorrowStr = getDateOffsetStr(1);
-        string dateStr;
+        DayNum todayDay = today();
+        DayNum date = NO_DATE;
 
         while (true) {
             cout << "\n-- Date Selection --\n";
-            cout << "1. Today    (" << todayStr << ")\n";
-            cout << "2. Tomorrow (" << tomorrowStr << ")\n";
+            cout << "1. Today    (" << dateString(todayDay) << ")\n";
+            cout << "2. Tomorrow (" << dateString(todayDay + 1) << ")\n";
             cout << "0. Return to Main Menu\n";
             cout << "Select: ";
 
@@ -842,13 +4181,14 @@ void bookFacility() {
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
 
             if (pick == 0) return;
-            if (pick == 1) { dateStr = todayStr; break; }
-            if (pick == 2) { dateStr = tomorrowStr; break; }
+            if (pick == 1) { date = todayDay; break; }
+            if (pick == 2) { date = todayDay + 1; break; }
 
             cout << "Invalid option.\n";
         }
 
-        bool weekend = isWeekendDate(dateStr);
+        bool weekend = isWeekend(date);
+        string dateStr = dateString(date);
         cout << "Date accepted: " << dateStr << " (" << (weekend ? "Weekend" : "Weekday") << ")\n";
 
         // =============== TYPE ===============
@@ -866,26 +4206,44 @@ void bookFacility() {
             if (!(cin >> entryChoice)) { clearBadInput(); cout << "Invalid option. Restarting...\n"; continue; }
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
 
-            double price = 0.0;
-            string name;
+            int facilityId;
 
             if (entryChoice == 1) {
-                price = weekend ? 8.0 : 5.0;
-                name = "Swimming Pool Entry";
+                facilityId = 3; // Swimming Pool Entry
                 cout << "Detected: " << (weekend ? "Weekend (RM 8)\n" : "Weekday (RM 5)\n");
             }
-            else if (entryChoice == 2) {
-                price = 10.0; name = "Gym Room Entry";
-            }
-            else if (entryChoice == 3) {
-                price = 30.0; name = "Fitness Studio Entry";
-            }
+            else if (entryChoice == 2) facilityId = 4; // Gym Room Entry
+            else if (entryChoice == 3) facilityId = 5; // Fitness Studio Entry
             else {
                 cout << "Invalid option. Restarting...\n";
                 continue;
             }
 
-            addToCart("Booking: " + name + " [" + dateStr + "]", price);
+            // =============== SESSION ===============
+            int capacity = FACILITIES[facilityId].capacity;
+            int firstOpen = nextEntrySession(date);
+            cout << "\n-- Sessions (" << dateStr << ") --\n";
+            for (int i = 0; i < ENTRY_SESSIONS; i++) {
+                int start = OPEN_MINUTE + i * ENTRY_SESSION_MINUTES;
+                cout << i + 1 << ". " << slotHHMM(start) << "-" << slotHHMM(start + ENTRY_SESSION_MINUTES) << "  ";
+                int people = entryOccupancyOf(facilityId, date, i);
+                if (i < firstOpen) cout << "(closed)";
+                else if (capacity > 0 && people >= capacity) cout << "(FULL)";
+                else if (capacity > 0) cout << "(" << people << "/" << capacity << ")";
+                cout << "\n";
+            }
+            cout << "Select: ";
+
+            int sessionChoice;
+            if (!(cin >> sessionChoice)) { clearBadInput(); cout << "Invalid option. Restarting...\n"; continue; }
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+            SlotCheck check = checkEntrySession(facilityId, date, sessionChoice - 1);
+            if (check == SlotCheck::BadFormat) { cout << "Invalid option. Restarting...\n"; continue; }
+            if (check == SlotCheck::AlreadyPassed) { cout << "Error: That session has already ended. Restarting...\n"; continue; }
+            if (check == SlotCheck::Full) { cout << "Sorry. That session is full (max " << capacity << " people). Restarting...\n"; continue; }
+
+            addToCart(makeEntryItem(facilityId, date, sessionChoice - 1));
             return;
         }
 
@@ -900,86 +4258,56 @@ void bookFacility() {
         if (!(cin >> sport)) { clearBadInput(); cout << "Invalid option. Restarting...\n"; continue; }
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
 
-        string courtName;
-        double wk = 0, wknd = 0;
+        if (sport < 1 || sport > 3) { cout << "Invalid option. Restarting...\n"; continue; }
 
-        if (sport == 1) { courtName = "Badminton Court"; wk = 15; wknd = 20; }
-        else if (sport == 2) { courtName = "Pickleball Court"; wk = 15; wknd = 20; }
-        else if (sport == 3) { courtName = "Basketball Court"; wk = 40; wknd = 50; }
-        else { cout << "Invalid option. Restarting...\n"; continue; }
+        int facilityId = sport - 1; // Badminton / Pickleball / Basketball Court
+        string courtName = FACILITIES[facilityId].name;
 
-        double hourlyRate = weekend ? wknd : wk;
-        cout << "Auto Rate (" << (weekend ? "Weekend" : "Weekday") << "): RM " << hourlyRate << " / hour\n";
+        Cents hourlyRate = entryPriceCents(facilityId, weekend);
+        cout << "Auto Rate (" << (weekend ? "Weekend" : "Weekday") << "): RM " << moneyString(hourlyRate) << " / hour\n";
+        printCourtAvailability(date, facilityId);
 
         // =============== TIME SELECTION ===============
         while (true) {
             int startTime = 0, endTime = 0;
 
             string s;
-            cout << "\nStart Time (HHMM, e.g. 1330): ";
-            getline(cin, s);
-            try { startTime = stoi(trimCopy(s)); }
-            catch (...) { cout << "Invalid option. Restarting...\n"; break; }
-
-            cout << "End Time   (HHMM, e.g. 1430): ";
-            getline(cin, s);
-            try { endTime = stoi(trimCopy(s)); }
-            catch (...) { cout << "Invalid option. Restarting...\n"; break; }
-
-            if (!isValidHHMM(startTime) || !isValidHHMM(endTime)) {
-                cout << "Invalid time format. Restarting...\n";
-                break; // restart date selection
-            }
-
-            int startMin = toMinutes(startTime);
-            int endMin = toMinutes(endTime);
-
-            // Operating hours: 10:00 to 22:00
-            if (startMin < 10 * 60 || endMin > 22 * 60) {
-                cout << "Invalid time (outside operation hours). Restarting...\n";
-                break;
-            }
-
-            if (endMin <= startMin) {
-                cout << "Invalid time (end must be after start). Restarting...\n";
-                break;
-            }
-
-            if (endMin - startMin < 60) {
-                cout << "Minimum booking duration is 60 minutes. Restarting...\n";
-                break;
-            }
+            cout << "\nStart Time (HHMM, e.g. 1330): ";
+            getline(cin, s);
+            try { startTime = stoi(trimCopy(s)); }
+            catch (...) { cout << "Invalid option. Restarting...\n"; break; }
 
-            // If booking is TODAY and start time already passed -> restart
-            if (dateStr == todayStr) {
-                time_t now = time(nullptr);
-                tm cur{};
-#ifdef _WIN32
-                localtime_s(&cur, &now);
-#else
-                cur = *localtime(&now);
-#endif
-                int currentMin = cur.tm_hour * 60 + cur.tm_min;
+            cout << "End Time   (HHMM, e.g. 1430): ";
+            getline(cin, s);
+            try { endTime = stoi(trimCopy(s)); }
+            catch (...) { cout << "Invalid option. Restarting...\n"; break; }
 
-                if (startMin <= currentMin) {
-                    cout << "Error: Time has already passed for today. Restarting...\n";
-                    break;
+            int court = -1;
+            SlotCheck check = checkCourtSlot(facilityId, date, startTime, endTime, court);
+
+            if (check == SlotCheck::Clash) {
+                // Clash check (ONLY re-enter time, do NOT restart)
+                cout << "ERROR: Every " << courtName << " is booked at that time on " << dateStr << ".\n";
+                vector<CourtSlot> nearest = suggestCourtSlots(facilityId, date, startTime, endTime);
+                if (!nearest.empty()) {
+                    cout << "Nearest free:";
+                    for (const auto& n : nearest)
+                        cout << "  " << slotHHMM(n.startMin) << "-" << slotHHMM(n.endMin) << " (Court " << n.court + 1 << ")";
+                    cout << "\n";
                 }
-            }
-
-            // Clash check (ONLY re-enter time, do NOT restart)
-            if (hasCourtClash(courtName, dateStr, startTime, endTime)) {
-                cout << "ERROR: This slot is already booked for " << courtName
-                    << " on " << dateStr << ".\n";
                 cout << "Please choose another time.\n";
                 continue; // re-enter time only
             }
 
-            double hours = (endMin - startMin) / 60.0;  // supports 90 mins = 1.5
-            double total = hourlyRate * hours;
+            // Anything else invalid -> restart date selection
+            if (check == SlotCheck::BadFormat) cout << "Invalid time format. Restarting...\n";
+            else if (check == SlotCheck::OutsideHours) cout << "Invalid time (outside operation hours). Restarting...\n";
+            else if (check == SlotCheck::EndBeforeStart) cout << "Invalid time (end must be after start). Restarting...\n";
+            else if (check == SlotCheck::TooShort) cout << "Minimum booking duration is 60 minutes. Restarting...\n";
+            else if (check == SlotCheck::AlreadyPassed) cout << "Error: Time has already passed for today. Restarting...\n";
+            if (check != SlotCheck::Ok) break;
 
-            addToCart("Booking: " + courtName + " [" + dateStr + " " +
-                to_string(startTime) + "-" + to_string(endTime) + "]", total);
+            addToCart(makeCourtItem(facilityId, court, date, startTime, endTime));
             return;
         }
 
@@ -1017,33 +4345,24 @@ void rentEquipment() {
         if (!(cin >> qty)) { clearBadInput(); continue; }
         if (qty <= 0) { cout << "Quantity must be at least 1.\n"; continue; }
 
-        string itemName;
-        double price = 0.0;
-        int depositPerUnit = 0; // 0 = no deposit
-
-        switch (choice) {
-        case 1: itemName = "Rent: Badminton Racket"; price = 10.0; depositPerUnit = 30; break;
-        case 2: itemName = "Rent: Paddle";          price = 8.0; depositPerUnit = 30; break;
-        case 3: itemName = "Rent: Basketball";      price = 10.0; depositPerUnit = 30; break;
-        case 4: itemName = "Rent: Resistance Band"; price = 5.0; depositPerUnit = 0;  break;
-        case 5: itemName = "Rent: Yoga Mat";        price = 5.0; depositPerUnit = 0;  break;
-        default:
+        if (choice < 1 || choice > RENTAL_COUNT) {
             cout << "Invalid choice.\n";
             continue;
         }
 
-        for (int i = 0; i < qty; i++) {
-            addToCart(itemName, price, true); // silent adds
-        }
+        const RentalDef& rental = RENTALS[choice - 1];
+        int depositPerUnit = rental.depositPerUnit; // 0 = no deposit
 
-        cout << ">> Added " << qty << " item(s): " << itemName << "\n";
+        addToCart(makeRentalItem(choice - 1, qty), true); // one line for all units
+
+        cout << ">> Added " << qty << " item(s): Rent: " << rental.name << "\n";
 
         if (depositPerUnit > 0) {
             cout << ">> Deposit at counter: RM " << (depositPerUnit * qty)
                 << " (RM " << depositPerUnit << " x " << qty << ")\n";
         }
 
-        cout << ">> Current bill: RM " << fixed << setprecision(2) << currentCartTotal << "\n";
+        cout << ">> Current bill: RM " << moneyString(currentSession->cartCents) << "\n";
     }
 }
 
@@ -1060,7 +4379,7 @@ void buyMerchandiseSnacks() {
         for (const auto& item : inventory) {
             cout << left << setw(5) << item.id
                 << setw(30) << item.name
-                << setw(12) << fixed << setprecision(2) << item.price
+                << setw(12) << moneyString(item.priceCents)
                 << right << setw(10) << item.stock << "\n";
         }
 
@@ -1074,10 +4393,9 @@ void buyMerchandiseSnacks() {
         }
 
         // Find product
-        auto it = find_if(inventory.begin(), inventory.end(),
-            [&](const Product& p) { return p.id == id; });
+        Product* it = findProduct(id);
 
-        if (it == inventory.end()) {
+        if (!it) {
             cout << "Item ID not found.\n";
             continue; // loop again
         }
@@ -1100,11 +4418,15 @@ void buyMerchandiseSnacks() {
             continue;
         }
 
-        it->stock -= qty;
+        if (buyProduct(id, qty) != BuyResult::Ok) {
+            cout << "Unable to add item.\n";
+            continue;
+        }
 
-        addToCart("Buy: " + it->name + " x " + to_string(qty), it->price * qty);
+        cout << ">> Added Buy: " << it->name << " x " << qty << " (RM " << moneyString(it->priceCents * qty)
+            << ") to bill.\n";
         cout << ">> Added to cart successfully!\n";
-        cout << ">> Current bill: RM " << fixed << setprecision(2) << currentCartTotal << "\n";
+        cout << ">> Current bill: RM " << moneyString(currentSession->cartCents) << "\n";
     }
 }
 
@@ -1121,19 +4443,15 @@ void lockerRental() {
     if (!(cin >> choice)) { clearBadInput(); return; }
     if (choice == 0) return;
 
-    double price = 0.0;
-    string label;
+    if (choice < 1 || choice > LOCKER_COUNT) { cout << "Invalid.\n"; return; }
 
-    if (choice == 1) { label = "Locker: Small"; price = 5.0; }
-    else if (choice == 2) { label = "Locker: Medium"; price = 8.0; }
-    else if (choice == 3) { label = "Locker: Large"; price = 10.0; }
-    else { cout << "Invalid.\n"; return; }
+    LineItem item = makeLockerItem(choice - 1);
 
-    cout << label << " is RM " << fixed << setprecision(2) << price << ". Proceed? (y/n): ";
+    cout << itemLabel(item) << " is RM " << moneyString(item.unitCents) << ". Proceed? (y/n): ";
     char yn;
     cin >> yn;
     if (yn == 'y' || yn == 'Y') {
-        addToCart(label, price);
+        addToCart(item);
         cout << "Locker added. Please take the key at counter.\n";
     }
     else {
@@ -1143,7 +4461,7 @@ void lockerRental() {
 
 void checkoutPayment() {
     cout << "\n-- Checkout & Payment --\n";
-    if (currentCartTotal <= 0.0) {
+    if (currentSession->cartCents <= 0) {
         cout << "Cart is empty.\n";
         return;
     }
@@ -1156,16 +4474,14 @@ void checkoutPayment() {
     cin >> phoneInput;
 
     if (phoneInput != "N" && phoneInput != "n") {
-        for (const auto& m : members) {
-            if (m.phone == phoneInput) {
-                isMember = true;
-                finalName = m.name;
-                finalPhone = m.phone;
-                cout << ">> Member Identified: " << finalName << "\n";
-                break;
-            }
+        int slot = findMemberSlot(phoneInput);
+        if (slot >= 0) {
+            isMember = true;
+            finalName = members[slot].name;
+            finalPhone = members[slot].phone;
+            cout << ">> Member Identified: " << finalName << "\n";
         }
-        if (!isMember) {
+        else {
             cout << "Member not found. Proceeding as Non-Member.\n";
         }
     }
@@ -1190,44 +4506,27 @@ void checkoutPayment() {
 
     // Bill summary (group same lines)
     cout << "\n--- BILL SUMMARY ---\n";
-    map<string, int> billCounts;
-    for (const auto& s : currentCartItems) billCounts[s]++;
-
-    for (const auto& kv : billCounts) {
-        cout << "- " << kv.first;
-        if (kv.second > 1) cout << " x " << kv.second;
-        cout << "\n";
+    for (const auto& it : currentSession->cartItems) {
+        cout << "- " << itemLabel(it) << "  (RM " << moneyString(it.lineCents()) << ")\n";
     }
 
-    double subtotal = currentCartTotal;
+    Cents subtotal = currentSession->cartCents;
     cout << "------------------------------\n";
-    cout << left << setw(18) << "Subtotal (RM):" << right << setw(10) << fixed << setprecision(2) << subtotal << "\n";
+    cout << left << setw(18) << "Subtotal (RM):" << right << setw(10) << moneyString(subtotal) << "\n";
 
     // Promo
-    double promoDiscount = getPromoDiscount(subtotal);
-    double afterPromo = subtotal - promoDiscount;
-    if (afterPromo < 0) afterPromo = 0;
+    Bill bill = computeBill(subtotal, getPromoDiscount(subtotal), isMember);
 
-    if (promoDiscount > 0) {
-        cout << left << setw(18) << "Promo (-RM):" << right << setw(10) << fixed << setprecision(2) << promoDiscount << "\n";
+    if (bill.promoDiscount > 0) {
+        cout << left << setw(18) << "Promo (-RM):" << right << setw(10) << moneyString(bill.promoDiscount) << "\n";
     }
-
-    // Member discount
-    double memberDiscount = 0.0;
-    double afterMember = afterPromo;
     if (isMember) {
-        memberDiscount = afterPromo * 0.10;
-        afterMember -= memberDiscount;
-        cout << left << setw(18) << "Member (-RM):" << right << setw(10) << fixed << setprecision(2) << memberDiscount << "\n";
+        cout << left << setw(18) << "Member (-RM):" << right << setw(10) << moneyString(bill.memberDiscount) << "\n";
     }
 
-    // SST
-    double tax = afterMember * 0.06;
-    double grandTotal = afterMember + tax;
-
-    cout << left << setw(18) << "SST 6% (RM):" << right << setw(10) << fixed << setprecision(2) << tax << "\n";
+    cout << left << setw(18) << "SST 6% (RM):" << right << setw(10) << moneyString(bill.tax) << "\n";
     cout << "------------------------------\n";
-    cout << left << setw(18) << "GRAND TOTAL:" << right << setw(10) << fixed << setprecision(2) << grandTotal << "\n";
+    cout << left << setw(18) << "GRAND TOTAL:" << right << setw(10) << moneyString(bill.grandTotal) << "\n";
     cout << "------------------------------\n";
 
     // Payment method
@@ -1237,16 +4536,14 @@ void checkoutPayment() {
 
     // Create booking record
     BookingRecord b;
-    b.bookingID = nextBookingID++;
-    b.customerName = finalName;
-    b.customerPhone = finalPhone;
-    b.totalAmount = grandTotal;
-    b.items = currentCartItems;
-    b.dateStr = getCurrentTimestamp(true);
-
-    allBookings.push_back(b);
-
-    saveData();
+    CheckoutResult result = commitCheckout(finalName, finalPhone, bill.grandTotal, b);
+    if (result != CheckoutResult::Ok) {
+        if (result == CheckoutResult::CourtTaken) cout << "ERROR! A court slot in your cart was just booked at another counter.\n";
+        else if (result == CheckoutResult::SessionFull) cout << "ERROR! An entry session in your cart was just filled at another counter.\n";
+        else cout << "ERROR! The sale could not be saved to disk.\n";
+        cout << "Payment cancelled. Please clear the cart and book another time.\n";
+        return;
+    }
 
     cout << "\n=========================================\n";
     cout << "   PAYMENT SUCCESSFUL!\n";
@@ -1254,8 +4551,7 @@ void checkoutPayment() {
     cout << "   Name: " << finalName << "\n";
     cout << "=========================================\n";
     cout << "Please keep this ID for cancellation/reference.\n";
-
-    clearCart();
+    cout << "Cart cleared.\n";
 }
 
 void feedback() {
@@ -1272,7 +4568,12 @@ void feedback() {
     comment = trimCopy(comment);
 
     feedbackList.push_back("Rating: " + to_string(rating) + " | " + comment);
-    saveData();
+    journalFeedback(feedbackList.size() - 1, feedbackList.back());
+    if (!journalSync()) {
+        feedbackList.pop_back();
+        cout << "Sorry, your feedback could not be saved to disk.\n";
+        return;
+    }
     cout << "Thank you!\n";
 }
 
@@ -1283,65 +4584,40 @@ void customerRefund() {
     cout << "Enter your Booking ID: ";
     if (!(cin >> targetID)) { clearBadInput(); return; }
 
-    for (size_t i = 0; i < allBookings.size(); ++i) {
-        if (allBookings[i].bookingID != targetID) continue;
-
-        cout << "\n-- Booking Found --\n";
-        cout << left << setw(14) << "Name" << ": " << allBookings[i].customerName << "\n";
-        cout << left << setw(14) << "Date" << ": " << allBookings[i].dateStr << "\n";
-        cout << left << setw(14) << "Total Paid" << ": RM " << fixed << setprecision(2)
-            << allBookings[i].totalAmount << "\n";
-        cout << left << setw(14) << "Items" << ":\n";
-        for (const auto& it : allBookings[i].items) cout << " - " << it << "\n";
-
-        char confirm;
-        cout << "\nCancel and refund? (y/n): ";
-        cin >> confirm;
-
-        if (confirm == 'y' || confirm == 'Y') {
-
-            // ================= RESTOCK HERE =================
-            for (const string& line : allBookings[i].items) {
-                // only restock merchandise/snacks
-                if (line.rfind("Buy:", 0) != 0) continue;
-
-                // Expected: "Buy: Product Name x N"
-                string rest = trimCopy(line.substr(4)); // after "Buy:"
-                size_t pos = rest.find(" x ");
-                if (pos == string::npos) continue;
-
-                string productName = trimCopy(rest.substr(0, pos));
-                int qty = 0;
-                try { qty = stoi(trimCopy(rest.substr(pos + 3))); }
-                catch (...) { continue; }
-
-                if (qty <= 0) continue;
-
-                for (auto& p : inventory) {
-                    if (p.name == productName) {
-                        p.stock += qty;
-                        break;
-                    }
-                }
-            }
-            // ================================================
-
-            cout << ">> Refund Processed: RM " << fixed << setprecision(2)
-                << allBookings[i].totalAmount << " returned.\n";
+    int slot = findBookingSlot(targetID);
+    if (slot < 0) {
+        cout << "Sorry. Booking ID not found.\n";
+        return;
+    }
+    const BookingRecord& b = allBookings[slot];
+
+    cout << "\n-- Booking Found --\n";
+    cout << left << setw(14) << "Name" << ": " << customerText(b.customerName) << "\n";
+    cout << left << setw(14) << "Date" << ": " << stampString(b.day, b.minute) << "\n";
+    cout << left << setw(14) << "Total Paid" << ": RM " << moneyString(b.totalCents) << "\n";
+    cout << left << setw(14) << "Items" << ":\n";
+    for (const auto& it : b.items) {
+        cout << " - " << itemLabel(it) << "  (RM " << moneyString(it.lineCents()) << ")\n";
+    }
 
-            allBookings.erase(allBookings.begin() + i);
-            saveData();
+    char confirm;
+    cout << "\nCancel and refund? (y/n): ";
+    cin >> confirm;
 
-            cout << ">> Booking ID " << targetID << " deleted.\n";
-        }
-        else {
-            cout << "Cancellation aborted.\n";
+    if (confirm == 'y' || confirm == 'Y') {
+        Cents paid = b.totalCents; // b goes away with the booking
+        RefundResult result = refundBooking(targetID);
+        if (result != RefundResult::Ok) {
+            cout << ">> Refund failed for booking ID " << targetID
+                << (result == RefundResult::NotSaved ? ": it could not be saved to disk" : "") << ". No money returned.\n";
+            return;
         }
-
-        return;
+        cout << ">> Refund Processed: RM " << moneyString(paid) << " returned.\n";
+        cout << ">> Booking ID " << targetID << " deleted.\n";
+    }
+    else {
+        cout << "Cancellation aborted.\n";
     }
-
-    cout << "Sorry. Booking ID not found.\n";
 }
 
 
@@ -1366,18 +4642,18 @@ void adminInventoryManage() {
             for (const auto& p : inventory) {
                 cout << left << setw(5) << p.id
                     << left << setw(28) << p.name
-                    << right << setw(10) << fixed << setprecision(2) << p.price
+                    << right << setw(10) << moneyString(p.priceCents)
                     << right << setw(10) << p.stock << "\n";
             }
-            pause();
+            pauseScreen();
         }
         else if (c == 2) {
             int id, addQty;
             cout << "Enter Product ID to restock: ";
             if (!(cin >> id)) { clearBadInput(); continue; }
 
-            auto it = find_if(inventory.begin(), inventory.end(), [&](const Product& p) { return p.id == id; });
-            if (it == inventory.end()) { cout << "ID not found.\n"; continue; }
+            Product* it = findProduct(id);
+            if (!it) { cout << "ID not found.\n"; continue; }
 
             cout << "Selected: " << it->name << " | Current stock: " << it->stock << "\n";
             cout << "Enter quantity to add: ";
@@ -1385,15 +4661,21 @@ void adminInventoryManage() {
             if (addQty <= 0) { cout << "Invalid quantity.\n"; continue; }
 
             it->stock += addQty;
-            saveData();
+            journalStock(*it);
+            if (!journalSync()) {
+                it->stock -= addQty;
+                cout << "Restock could not be saved to disk. Stock unchanged: " << it->stock << "\n";
+                continue;
+            }
             cout << "Restocked! New stock: " << it->stock << "\n";
-            pause();
+            pauseScreen();
         }
         else if (c == 3) {
             Product p{};
             cout << "Enter new item ID: ";
             if (!(cin >> p.id)) { clearBadInput(); continue; }
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            if (p.id <= 0 || p.id > MAX_PRODUCT_ID) { cout << "Invalid ID (1-" << MAX_PRODUCT_ID << ").\n"; continue; }
 
             cout << "Enter name: ";
             getline(cin, p.name);
@@ -1401,24 +4683,38 @@ void adminInventoryManage() {
             if (p.name.empty()) { cout << "Invalid name.\n"; continue; }
 
             cout << "Enter price: ";
-            if (!(cin >> p.price)) { clearBadInput(); continue; }
+            if (!readMoney(cin, p.priceCents)) { clearBadInput(); continue; }
             cout << "Enter stock: ";
             if (!(cin >> p.stock)) { clearBadInput(); continue; }
-            if (p.stock < 0 || p.price < 0) { cout << "Invalid price/stock.\n"; continue; }
+            if (p.stock < 0 || p.priceCents < 0) { cout << "Invalid price/stock.\n"; continue; }
 
-            if (find_if(inventory.begin(), inventory.end(), [&](const Product& x) { return x.id == p.id; }) != inventory.end()) {
+            if (findProduct(p.id)) {
                 cout << "ID already exists.\n";
                 continue;
             }
 
-            inventory.push_back(p);
+            journalProduct(p);
+            if (!journalSync()) {
+                cout << "Item could not be saved to disk. Not added.\n";
+                continue;
+            }
+            addProduct(p);
             cout << "Item added.\n";
-            pause();
+            pauseScreen();
         }
         else if (c == 4) {
+            // No journal record replaces the whole inventory, so the reset
+            // only stands once a checkpoint has saved it
+            vector<Product> previous = inventory;
             loadDefaultsInventory();
+            if (!checkpoint()) {
+                inventory = move(previous);
+                rebuildProductCatalog();
+                cout << "Inventory reset could not be saved to disk. Inventory unchanged.\n";
+                continue;
+            }
             cout << "Inventory reset to defaults.\n";
-            pause();
+            pauseScreen();
         }
         else if (c == 5) {
             return;
@@ -1444,31 +4740,53 @@ void adminViewBookings() {
         cin >> targetDate;
         targetDate = trimCopy(targetDate);
     }
+    DayNum targetDay = NO_DATE;
+    if (viewType == 2 && !parseDate(targetDate, targetDay)) {
+        cout << "Invalid date. Use DD/MM/YYYY.\n";
+        return;
+    }
 
     bool foundAny = false;
-
-    for (const auto& b : allBookings) {
-        bool ok = (viewType == 1);
-        if (viewType == 2) {
-            if (b.dateStr.size() >= 10 && b.dateStr.substr(0, 10) == targetDate) ok = true;
-        }
-
-        if (!ok) continue;
+    auto printBooking = [&](const BookingRecord& b) {
         foundAny = true;
+        cout << "\nID: " << b.bookingID << " | Date: " << stampString(b.day, b.minute)
+            << " | " << customerText(b.customerName) << " (" << customerText(b.customerPhone) << ") | RM "
+            << moneyString(b.totalCents) << "\n";
 
-        cout << "\nID: " << b.bookingID << " | Date: " << b.dateStr
-            << " | " << b.customerName << " (" << b.customerPhone << ") | RM "
-            << fixed << setprecision(2) << b.totalAmount << "\n";
-
-        map<string, int> counts;
-        for (const auto& item : b.items) counts[item]++;
-
-        for (const auto& kv : counts) {
-            cout << "   > " << kv.first;
-            if (kv.second > 1) cout << " x " << kv.second;
-            cout << "\n";
+        for (const auto& item : b.items) {
+            cout << "   > " << itemLabel(item) << "  (RM " << moneyString(item.lineCents()) << ")\n";
         }
         cout << "------------------------------\n";
+    };
+
+    // By date: find the day's rows in the day column, then print only those
+    if (viewType == 2) {
+        ensureSegmentLoaded(targetDay);
+        for (int slot : bookingSlotsOnDay(targetDay)) printBooking(allBookings[slot]);
+    }
+    else if (viewType == 1) {
+        // Month by month; cold months are printed straight from their files
+        // without being loaded and indexed
+        map<int, vector<int>> loadedByMonth;
+        for (size_t i = 0; i < allBookings.size(); i++)
+            if (!allBookings[i].cancelled) loadedByMonth[monthIndexOf(allBookings[i].day)].push_back((int)i);
+        set<int> months;
+        for (const auto& kv : loadedByMonth) months.insert(kv.first);
+        for (const auto& kv : bookingSegments)
+            if (!kv.second.loaded) months.insert(kv.first);
+        for (int month : months) {
+            auto loaded = loadedByMonth.find(month);
+            if (loaded != loadedByMonth.end()) {
+                for (int slot : loaded->second) printBooking(allBookings[slot]);
+                continue;
+            }
+            vector<BookingRecord> records;
+            if (!readSegmentFile(month, records)) {
+                cout << "[System] ERROR: cannot read " << segmentPath(month) << "\n";
+                continue;
+            }
+            for (const auto& b : records) printBooking(b);
+        }
     }
 
     if (!foundAny) {
@@ -1497,7 +4815,8 @@ void adminStaffLogin() {
         cout << "5. View Bookings\n";
         cout << "6. Remove Booking\n";
         cout << "7. Daily/Monthly Report\n";
-        cout << "8. Logout\nChoice: ";
+        cout << "8. Performance Metrics\n";
+        cout << "9. Logout\nChoice: ";
 
         if (!(cin >> adminChoice)) { clearBadInput(); continue; }
 
@@ -1507,29 +4826,28 @@ void adminStaffLogin() {
             for (const auto& m : members) {
                 cout << "Name: " << m.name << " (" << m.phone << ")\n";
                 cout << " - Type  : " << m.type << "\n";
-                cout << " - Join  : " << m.joinDate << "\n";
-                cout << " - Expiry: " << m.expiryDate << "\n\n";
+                cout << " - Join  : " << dateString(m.joinDate) << "\n";
+                cout << " - Expiry: " << dateString(m.expiryDate) << "\n\n";
             }
-            pause();
+            pauseScreen();
         }
         else if (adminChoice == 2) {
             string targetPhone;
             cout << "Enter Member Phone Number to Remove: ";
             cin >> targetPhone;
-            bool found = false;
+            int slot = findMemberSlot(targetPhone);
 
-            for (size_t i = 0; i < members.size(); ++i) {
-                if (members[i].phone == targetPhone) {
-                    cout << "Removing member: " << members[i].name << "...\n";
-                    members.erase(members.begin() + i);
-                    saveData();
+            if (slot >= 0) {
+                cout << "Removing member: " << members[slot].name << "...\n";
+                journalMemberRemove(targetPhone);
+                if (journalSync()) {
+                    removeMember(targetPhone);
                     cout << "Member deleted successfully.\n";
-                    found = true;
-                    break;
                 }
+                else cout << "Removal could not be saved to disk. Member kept.\n";
             }
-            if (!found) cout << "Member phone not found.\n";
-            pause();
+            else cout << "Member phone not found.\n";
+            pauseScreen();
         }
         else if (adminChoice == 3) {
             adminInventoryManage();
@@ -1538,37 +4856,35 @@ void adminStaffLogin() {
             cout << "\n--- Feedbacks ---\n";
             if (feedbackList.empty()) cout << "(No feedback yet)\n";
             for (const auto& f : feedbackList) cout << f << "\n";
-            pause();
+            pauseScreen();
         }
         else if (adminChoice == 5) {
             adminViewBookings();
-            pause();
+            pauseScreen();
         }
         else if (adminChoice == 6) {
             int idToDelete;
             cout << "Enter Booking ID to remove: ";
             cin >> idToDelete;
-            bool deleted = false;
-
-            for (size_t i = 0; i < allBookings.size(); ++i) {
-                if (allBookings[i].bookingID == idToDelete) {
-                    cout << "Removing booking for " << allBookings[i].customerName << "...\n";
-                    allBookings.erase(allBookings.begin() + i);
-                    saveData();
-                    cout << "Success.\n";
-                    deleted = true;
-                    break;
-                }
+
+            int slot = findBookingSlot(idToDelete);
+            if (slot >= 0) {
+                cout << "Removing booking for " << customerText(allBookings[slot].customerName) << "...\n";
+                RefundResult result = removeBooking(idToDelete);
+                if (result == RefundResult::Ok) cout << "Success.\n";
+                else if (result == RefundResult::NotSaved) cout << "Removal could not be saved to disk. Booking kept.\n";
+                else cout << "Booking is being refunded; try again.\n";
             }
-            if (!deleted) cout << "ID not found.\n";
-            pause();
+            else cout << "ID not found.\n";
+            pauseScreen();
         }
         else if (adminChoice == 7) {
             int reportChoice;
             cout << "\n-- Admin Report --\n";
-            cout << "1. Daily Report\n2. Monthly Report\nChoice: ";
+            cout << "1. Daily Report\n2. Monthly Report\n3. Date Range Report\n4. Top " << TOP_SELLERS_SHOWN << " Sellers\nChoice: ";
             cin >> reportChoice;
 
+            if (reportChoice == 1 || reportChoice == 2) loadColdReportFigures();
             if (reportChoice == 1) {
                 generateDailyReports();
                 checkDailyReport();
@@ -1577,17 +4893,801 @@ void adminStaffLogin() {
                 generateMonthlyReports();
                 checkMonthlyReport();
             }
+            else if (reportChoice == 3) {
+                string fromStr, toStr;
+                DayNum from, to;
+                cout << "From (DD/MM/YYYY): ";
+                cin >> fromStr;
+                cout << "To   (DD/MM/YYYY): ";
+                cin >> toStr;
+                if (!parseDate(trimCopy(fromStr), from) || !parseDate(trimCopy(toStr), to) || from > to)
+                    cout << "Invalid range. Use DD/MM/YYYY, earliest date first.\n";
+                else printSalesRange(from, to);
+            }
+            else if (reportChoice == 4) {
+                string key;
+                int k;
+                cout << "Day (DD/MM/YYYY) or month (YYYY-MM): ";
+                cin >> key;
+                key = trimCopy(key);
+                const map<int, SalesAggregate>* aggs = nullptr;
+                if (parseDate(key, k)) {
+                    aggs = &dailyAgg;
+                    ensureSegmentLoaded(k);
+                }
+                else if (parseMonth(key, k)) {
+                    aggs = &monthlyAgg;
+                    loadSegment(k);
+                }
+
+                if (!aggs) cout << "Invalid date. Use DD/MM/YYYY or YYYY-MM.\n";
+                else {
+                    auto found = aggs->find(k);
+                    if (!printTopSellers(found == aggs->end() ? nullptr : &found->second, key))
+                        cout << "No sales for " << key << ".\n";
+                }
+            }
             else {
                 cout << "Invalid.\n";
             }
-            pause();
+            pauseScreen();
+        }
+        else if (adminChoice == 8) {
+            cout << "\n--- Performance Metrics ---\n";
+            printMetrics(cout);
+            dumpMetrics();
+            cout << "(Also written to " << FILE_METRICS << ")\n";
+            pauseScreen();
+        }
+
+    } while (adminChoice != 9);
+}
+
+// ================= HEADLESS REPLAY =================
+// Runs a script of counter operations through the POS OPERATIONS layer with a
+// scripted clock, then prints throughput and latency percentiles per op.
+// Several scripts run as concurrent lanes, each with its own cart and clock.
+// One op per line, '#' starts a comment:
+//   CLOCK dd/mm/yyyy hh:mm           set "now" (date ops below are relative to it)
+//   BOOK <court 1-3> <day 0|1> <HHMM> <HHMM>
+//   ENTRY <entry 1-3> <day 0|1> [session HHMM]
+//   BUY <productId> <qty>
+//   RENT <item 1-5> <qty>
+//   LOCKER <size 1-3>
+//   CHECKOUT <phone> <promo|-> [name]
+//   REFUND <bookingId>
+//   CLEAR
+//   CART                              list the cart
+//   FREE <day 0|1> [minutes]          free court stretches (default 60 min)
+//   REPORT DAILY dd/mm/yyyy | REPORT MONTHLY yyyy-mm
+//   REPORT RANGE dd/mm/yyyy dd/mm/yyyy  sales between two dates, inclusive
+//   TOP DAILY dd/mm/yyyy [k] | TOP MONTHLY yyyy-mm [k]  top k sellers per category (default 10)
+thread_local time_t replayTime = 0;
+
+time_t replayClock() {
+    return replayTime;
+}
+
+static bool parseClockArgs(const string& dateStr, const string& timeStr, time_t& out) {
+    DayNum day;
+    int minute;
+    if (!parseDate(dateStr, day) || !parseTimeOfDay(timeStr.data(), timeStr.size(), minute)) return false;
+
+    CivilDate c = civilFromDay(day);
+    tm t{};
+    t.tm_year = c.y - 1900;
+    t.tm_mon = c.m - 1;
+    t.tm_mday = c.d;
+    t.tm_hour = minute / 60;
+    t.tm_min = minute % 60;
+    t.tm_isdst = -1;
+    out = mktime(&t);
+    return true;
+}
+
+static const char* slotCheckText(SlotCheck c) {
+    switch (c) {
+    case SlotCheck::BadFormat: return "invalid time format";
+    case SlotCheck::OutsideHours: return "outside operating hours";
+    case SlotCheck::EndBeforeStart: return "end time must be later than start time";
+    case SlotCheck::TooShort: return "minimum booking is 1 hour";
+    case SlotCheck::AlreadyPassed: return "start time already passed";
+    case SlotCheck::Clash: return "time clash";
+    case SlotCheck::Full: return "session full";
+    default: return "ok";
+    }
+}
+
+// Apply one script line. Returns false (with the reason in reply) if the op was rejected.
+bool runScriptOp(const string& line, string& reply) {
+    istringstream in(line);
+    string op;
+    in >> op;
+    for (auto& c : op) c = (char)toupper((unsigned char)c);
+    reply.clear();
+
+    if (op == "CLOCK") {
+        string dateStr, timeStr;
+        in >> dateStr >> timeStr;
+        if (!parseClockArgs(dateStr, timeStr, replayTime)) { reply = "bad clock"; return false; }
+        reply = getCurrentTimestamp(true);
+        return true;
+    }
+    if (op == "BOOK" || op == "ENTRY") {
+        bool court = (op == "BOOK");
+        int choice, day, startHHMM = 0, endHHMM = 0;
+        if (!(in >> choice >> day) || choice < 1 || choice > 3 || (day != 0 && day != 1)) { reply = "bad arguments"; return false; }
+        if (court && !(in >> startHHMM >> endHHMM)) { reply = "bad arguments"; return false; }
+
+        DayNum date = today() + day;
+        ostringstream os;
+        if (!court) {
+            // Optional session start time; default is the first session still running
+            int facilityId = choice + 2, session = nextEntrySession(date);
+            if (in >> startHHMM) {
+                int offset = isValidHHMM(startHHMM) ? toMinutes(startHHMM) - OPEN_MINUTE : -1;
+                session = offset >= 0 && offset % ENTRY_SESSION_MINUTES == 0 ? offset / ENTRY_SESSION_MINUTES : -1;
+            }
+            SlotCheck check = checkEntrySession(facilityId, date, session);
+            if (check != SlotCheck::Ok) { reply = slotCheckText(check); return false; }
+            addToCart(makeEntryItem(facilityId, date, session), true);
+            os << "session " << slotHHMM(OPEN_MINUTE + session * ENTRY_SESSION_MINUTES) << ", ";
+        }
+        else {
+            int facilityId = choice - 1, courtNo = -1;
+            SlotCheck check = checkCourtSlot(facilityId, date, startHHMM, endHHMM, courtNo);
+            if (check != SlotCheck::Ok) {
+                os << slotCheckText(check);
+                if (check == SlotCheck::Clash) {
+                    for (const auto& n : suggestCourtSlots(facilityId, date, startHHMM, endHHMM))
+                        os << ", try " << slotHHMM(n.startMin) << "-" << slotHHMM(n.endMin)
+                            << " court " << n.court + 1;
+                }
+                reply = os.str();
+                return false;
+            }
+            addToCart(makeCourtItem(facilityId, courtNo, date, startHHMM, endHHMM), true);
+            os << "court " << courtNo + 1 << ", ";
+        }
+        os << "cart RM " << moneyString(currentSession->cartCents);
+        reply = os.str();
+        return true;
+    }
+    if (op == "FREE") {
+        int day, minutes = MIN_COURT_MINUTES;
+        if (!(in >> day) || (day != 0 && day != 1)) { reply = "bad arguments"; return false; }
+        if (!(in >> minutes)) minutes = MIN_COURT_MINUTES;
+        if (minutes <= 0) { reply = "bad arguments"; return false; }
+
+        ostringstream os;
+        for (const auto& c : findFreeCourtSlots(today() + day, minutes)) {
+            os << (os.tellp() > 0 ? " | " : "") << FACILITIES[c.facilityId].name << " " << c.court + 1 << ":";
+            if (c.free.empty()) os << " none";
+            for (const auto& r : c.free) os << " " << slotHHMM(r.first) << "-" << slotHHMM(r.second);
+        }
+        reply = os.str();
+        return true;
+    }
+    if (op == "BUY") {
+        int id, qty;
+        if (!(in >> id >> qty)) { reply = "bad arguments"; return false; }
+        switch (buyProduct(id, qty)) {
+        case BuyResult::Ok: break;
+        case BuyResult::NotFound: reply = "product not found"; return false;
+        case BuyResult::OutOfStock: reply = "out of stock"; return false;
+        case BuyResult::BadQuantity: reply = "bad quantity"; return false;
+        case BuyResult::NotEnoughStock: reply = "not enough stock"; return false;
+        }
+        ostringstream os;
+        os << "cart RM " << moneyString(currentSession->cartCents);
+        reply = os.str();
+        return true;
+    }
+    if (op == "RENT" || op == "LOCKER") {
+        int choice, qty = 1;
+        if (!(in >> choice)) { reply = "bad arguments"; return false; }
+        if (op == "RENT") {
+            if (!(in >> qty) || qty <= 0 || choice < 1 || choice > RENTAL_COUNT) { reply = "bad arguments"; return false; }
+            addToCart(makeRentalItem(choice - 1, qty), true);
+        }
+        else {
+            if (choice < 1 || choice > LOCKER_COUNT) { reply = "bad arguments"; return false; }
+            addToCart(makeLockerItem(choice - 1), true);
+        }
+        ostringstream os;
+        os << "cart RM " << moneyString(currentSession->cartCents);
+        reply = os.str();
+        return true;
+    }
+    if (op == "CHECKOUT") {
+        string phone, promo, name;
+        if (!(in >> phone >> promo)) { reply = "bad arguments"; return false; }
+        getline(in, name);
+        name = trimCopy(name);
+        if (currentSession->cartCents <= 0) { reply = "cart is empty"; return false; }
+
+        bool isMember = false;
+        {
+            lock_guard<mutex> lock(storeMutex);
+            int slot = findMemberSlot(phone);
+            isMember = slot >= 0;
+            if (isMember) name = members[slot].name;
+        }
+        if (!isMember && !isDigitsOnly(phone)) { reply = "invalid phone"; return false; }
+        if (name.empty()) name = "Walk-in";
+
+        Cents promoDiscount = 0;
+        if (promo != "-") {
+            promoDiscount = promoDiscountFor(promo, currentSession->cartCents);
+            if (promoDiscount < 0) { reply = "invalid promo code"; return false; }
+        }
+
+        Bill bill = computeBill(currentSession->cartCents, promoDiscount, isMember);
+        BookingRecord b;
+        CheckoutResult result = commitCheckout(name, phone, bill.grandTotal, b);
+        if (result == CheckoutResult::CourtTaken) { reply = "court slot taken"; return false; }
+        if (result == CheckoutResult::SessionFull) { reply = "entry session full"; return false; }
+        if (result == CheckoutResult::NotSaved) { reply = "not saved: journal write failed"; return false; }
+        ostringstream os;
+        os << "booking " << b.bookingID << " RM " << moneyString(b.totalCents);
+        reply = os.str();
+        return true;
+    }
+    if (op == "REFUND") {
+        int id;
+        if (!(in >> id)) { reply = "bad arguments"; return false; }
+        RefundResult result = refundBooking(id);
+        if (result == RefundResult::NotFound) { reply = "booking not found"; return false; }
+        if (result == RefundResult::NotSaved) { reply = "not saved: journal write failed"; return false; }
+        reply = "refunded " + to_string(id);
+        return true;
+    }
+    if (op == "CLEAR") {
+        currentSession->cartItems.clear();
+        currentSession->cartCents = 0;
+        reply = "cart cleared";
+        return true;
+    }
+    if (op == "CART") {
+        ostringstream os;
+        os << "RM " << moneyString(currentSession->cartCents);
+        lock_guard<mutex> lock(storeMutex); // product names
+        for (const auto& it : currentSession->cartItems) os << "; " << itemLabel(it);
+        reply = os.str();
+        return true;
+    }
+    if (op == "REPORT") {
+        string period, key;
+        in >> period >> key;
+        for (auto& c : period) c = (char)toupper((unsigned char)c);
+        if (period == "RANGE") {
+            string toKey;
+            DayNum from, to;
+            in >> toKey;
+            if (!parseDate(key, from) || !parseDate(toKey, to) || from > to) { reply = "bad date range"; return false; }
+
+            lock_guard<mutex> lock(storeMutex);
+            SalesTotals t = salesBetween(from, to);
+            ostringstream os;
+            os << key << " - " << toKey << " tx " << t.transactions << " sales RM " << moneyString(t.salesCents);
+            for (int k = 0; k < ITEM_KIND_COUNT; k++)
+                if (t.kindCents[k] != 0) os << " | " << ITEM_KIND_NAMES[k] << " RM " << moneyString(t.kindCents[k]);
+            reply = os.str();
+            return true;
+        }
+        if ((period != "DAILY" && period != "MONTHLY") || key.empty()) { reply = "bad arguments"; return false; }
+
+        int k;
+        bool daily = period == "DAILY";
+        if (!(daily ? parseDate(key, k) : parseMonth(key, k))) { reply = "bad date"; return false; }
+
+        lock_guard<mutex> lock(storeMutex);
+        if (daily) ensureSegmentLoaded(k);
+        else loadSegment(k);
+        const map<int, SalesAggregate>& aggs = daily ? dailyAgg : monthlyAgg;
+        auto found = aggs.find(k);
+        if (found == aggs.end() || found->second.totalTransactions == 0) { reply = "no data for " + key; return false; }
+
+        const SalesAggregate& a = found->second;
+        ostringstream os;
+        os << key << " tx " << a.totalTransactions << " sales RM " << moneyString(a.salesCents)
+            << " | booking: " << getBestItem(a, ItemKind::Booking)
+            << " | rental: " << getBestItem(a, ItemKind::Rental)
+            << " | product: " << getBestItem(a, ItemKind::Product);
+        reply = os.str();
+        return true;
+    }
+
+    if (op == "TOP") {
+        string period, key;
+        in >> period >> key;
+        int count = (int)TOP_SELLERS_SHOWN;
+        if (!(in >> count)) count = (int)TOP_SELLERS_SHOWN;
+        for (auto& c : period) c = (char)toupper((unsigned char)c);
+        if ((period != "DAILY" && period != "MONTHLY") || key.empty() || count <= 0) { reply = "bad arguments"; return false; }
+
+        int k;
+        bool daily = period == "DAILY";
+        if (!(daily ? parseDate(key, k) : parseMonth(key, k))) { reply = "bad date"; return false; }
+
+        lock_guard<mutex> lock(storeMutex);
+        if (daily) ensureSegmentLoaded(k);
+        else loadSegment(k);
+        const map<int, SalesAggregate>& aggs = daily ? dailyAgg : monthlyAgg;
+        auto found = aggs.find(k);
+        if (found == aggs.end() || found->second.totalTransactions == 0) { reply = "no data for " + key; return false; }
+
+        ostringstream os;
+        os << key;
+        for (ItemKind kind : { ItemKind::Booking, ItemKind::Rental, ItemKind::Product }) {
+            os << " | " << ITEM_KIND_NAMES[(int)kind] << ":";
+            vector<TopSeller> top = topSellers(found->second, kind, (size_t)count);
+            if (top.empty()) os << " -";
+            for (size_t i = 0; i < top.size(); i++) os << (i ? ", " : " ") << sellerString(top[i]);
+        }
+        reply = os.str();
+        return true;
+    }
+
+    reply = "unknown op " + op;
+    return false;
+}
+
+static double percentileOf(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+struct ReplayLane {
+    string path;
+    vector<pair<long, string>> lines; // (line number, op)
+    map<string, vector<double>> latencyUs; // op -> per-op latency
+    long failed = 0, transactions = 0;
+};
+
+static bool loadReplayScript(ReplayLane& lane) {
+    ifstream in(lane.path);
+    if (!in) return false;
+
+    string line;
+    long lineNo = 0;
+    while (getline(in, line)) {
+        lineNo++;
+        size_t hash = line.find('#');
+        if (hash != string::npos) line.erase(hash);
+        line = trimCopy(line);
+        if (!line.empty()) lane.lines.push_back({ lineNo, line });
+    }
+    return true;
+}
+
+mutex replayOutputMutex;
+
+// One lane: its own cart, booking-ID block and scripted clock
+static void runReplayLane(ReplayLane& lane, bool verbose, bool tagOutput) {
+    PosSession session;
+    currentSession = &session;
+    replayTime = time(nullptr);
+
+    for (const auto& entry : lane.lines) {
+        const string& line = entry.second;
+        string op = line.substr(0, line.find(' '));
+        for (auto& c : op) c = (char)toupper((unsigned char)c);
+
+        string reply;
+        auto t0 = chrono::steady_clock::now();
+        bool ok = runScriptOp(line, reply);
+        auto t1 = chrono::steady_clock::now();
+
+        lane.latencyUs[op].push_back(chrono::duration<double, micro>(t1 - t0).count());
+        if (!ok) lane.failed++;
+        else if (op == "CHECKOUT" || op == "REFUND") lane.transactions++;
+
+        if (verbose || !ok) {
+            lock_guard<mutex> lock(replayOutputMutex);
+            if (tagOutput) cout << lane.path << ":";
+            cout << entry.first << ": " << line << " -> " << (ok ? "" : "FAILED: ") << reply << "\n";
+        }
+    }
+    currentSession = &consoleSession;
+}
+
+// Each script is one POS lane; several scripts run concurrently against the
+// shared store. Returns false if a script could not be opened.
+bool runReplay(const vector<string>& paths, bool verbose) {
+    vector<ReplayLane> lanes(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        lanes[i].path = paths[i];
+        if (!loadReplayScript(lanes[i])) {
+            cerr << "Cannot open replay script: " << paths[i] << "\n";
+            return false;
+        }
+    }
+
+    posClock = replayClock;
+    auto t0 = chrono::steady_clock::now();
+    if (lanes.size() == 1) {
+        runReplayLane(lanes[0], verbose, false);
+    }
+    else {
+        vector<thread> workers;
+        for (auto& lane : lanes) workers.emplace_back([&lane, verbose]() { runReplayLane(lane, verbose, true); });
+        for (auto& w : workers) w.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    posClock = systemClock;
+
+    map<string, vector<double>> latencyUs;
+    long ops = 0, failed = 0, transactions = 0;
+    for (auto& lane : lanes) {
+        for (auto& kv : lane.latencyUs) {
+            ops += (long)kv.second.size();
+            latencyUs[kv.first].insert(latencyUs[kv.first].end(), kv.second.begin(), kv.second.end());
+        }
+        failed += lane.failed;
+        transactions += lane.transactions;
+    }
+
+    cout << "\n--- Replay: " << lanes.size() << " lane(s) ---\n";
+    cout << "Ops: " << ops << " (" << failed << " failed), transactions: " << transactions << "\n";
+    cout << "Wall time: " << fixed << setprecision(3) << seconds * 1000.0 << " ms\n";
+    if (seconds > 0) {
+        cout << "Throughput: " << fixed << setprecision(0) << transactions / seconds << " tx/s, "
+            << ops / seconds << " ops/s\n";
+    }
+
+    cout << "\n" << left << setw(10) << "Op" << right << setw(10) << "Count"
+        << setw(10) << "p50 us" << setw(10) << "p90 us" << setw(10) << "p99 us" << setw(10) << "max us" << "\n";
+    for (auto& kv : latencyUs) {
+        vector<double>& v = kv.second;
+        sort(v.begin(), v.end());
+        cout << left << setw(10) << kv.first << right << setw(10) << v.size() << fixed << setprecision(1)
+            << setw(10) << percentileOf(v, 50) << setw(10) << percentileOf(v, 90)
+            << setw(10) << percentileOf(v, 99) << setw(10) << v.back() << "\n";
+    }
+    return true;
+}
+
+// ================= DATA DIRECTORY LOCK =================
+// Only one process may write the data files of a directory: the daemon, the
+// console, or a --replay-persist run. Each holds an exclusive lock on
+// pos.lock for its lifetime; the OS drops it when the process exits, crash
+// included, so there is nothing stale to clean up.
+const char* FILE_LOCK = "pos.lock";
+
+// False if another process holds the lock
+bool lockDataDirectory() {
+#ifdef _WIN32
+    static HANDLE lockHandle = INVALID_HANDLE_VALUE; // kept open until exit
+    lockHandle = CreateFileA(FILE_LOCK, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return lockHandle != INVALID_HANDLE_VALUE;
+#else
+    static int lockFd = -1; // kept open until exit
+    lockFd = open(FILE_LOCK, O_RDWR | O_CREAT, 0644);
+    return lockFd >= 0 && flock(lockFd, LOCK_EX | LOCK_NB) == 0;
+#endif
+}
+
+// ================= DAEMON =================
+// One process owns the data and serves counter terminals over a Unix socket.
+// The protocol is line based: each request is one script op (see HEADLESS
+// REPLAY, CLOCK excluded) and each answer one line, "OK <text>" or
+// "ERR <text>". A single poll() loop serves every connection; each client
+// gets its own PosSession, so carts stay per terminal. A sale or refund is
+// not waited for in the loop: the client's answer is held until the journal
+// flusher reports its record (through a pipe the loop also polls), and the
+// client's next request is only read after that. Checkouts from many
+// terminals therefore share flushes and never stall each other.
+const char* DEFAULT_SOCKET = "pos.sock";
+const size_t MAX_REQUEST_LINE = 4096;
+
+#ifndef _WIN32
+volatile sig_atomic_t daemonStopping = 0;
+
+static void onDaemonSignal(int) {
+    daemonStopping = 1;
+}
+
+struct DaemonClient {
+    int fd = -1;
+    string in, out;
+    PosSession session;
+    string heldReply;     // answer to send once session.heldCommit is on disk
+    bool closing = false; // close once out is flushed
+};
+
+static bool fillSocketAddress(const string& path, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path.c_str());
+    return true;
+}
+
+// True if a daemon answers on the socket
+bool daemonIsRunning(const string& socketPath) {
+    sockaddr_un addr;
+    if (!fillSocketAddress(socketPath, addr)) return false;
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) return false;
+    bool live = connect(probe, (sockaddr*)&addr, sizeof(addr)) == 0;
+    close(probe);
+    return live;
+}
+
+static void handleDaemonRequest(DaemonClient& c, const string& raw) {
+    string line = trimCopy(raw);
+    if (line.empty()) return;
+
+    string op = line.substr(0, line.find(' '));
+    for (auto& ch : op) ch = (char)toupper((unsigned char)ch);
+
+    string reply;
+    bool ok;
+    if (op == "QUIT") {
+        ok = true;
+        reply = "bye";
+        c.closing = true;
+    }
+    else if (op == "CLOCK") {
+        ok = false;
+        reply = "the daemon uses the system clock";
+    }
+    else {
+        currentSession = &c.session;
+        ok = runScriptOp(line, reply);
+        currentSession = &consoleSession;
+    }
+    string answer = (ok ? "OK " : "ERR ") + reply + "\n";
+    if (c.session.heldCommit) c.heldReply = answer;
+    else c.out += answer;
+}
+
+// Requests already read, one at a time; stops at one whose answer is held
+static void serveBufferedRequests(DaemonClient& c) {
+    size_t nl;
+    while (!c.closing && !c.session.heldCommit && (nl = c.in.find('\n')) != string::npos) {
+        string line = c.in.substr(0, nl);
+        c.in.erase(0, nl + 1);
+        handleDaemonRequest(c, line);
+    }
+}
+
+// Sends held answers whose records the flusher is done with
+static void releaseHeldReplies(vector<DaemonClient>& clients) {
+    for (auto& c : clients) {
+        bool durable;
+        if (!c.session.heldCommit || !settleHeldCommit(c.session, durable)) continue;
+        c.out += durable ? c.heldReply : "ERR not saved: journal write failed\n";
+        c.heldReply.clear();
+        serveBufferedRequests(c);
+    }
+}
+
+// Returns false if the socket could not be set up
+bool runDaemon(const string& socketPath) {
+    sockaddr_un addr;
+    if (!fillSocketAddress(socketPath, addr)) {
+        cerr << "Socket path too long: " << socketPath << "\n";
+        return false;
+    }
+
+    // A socket file nobody answers on is left over from a crash; a live one
+    // means another daemon already owns the data.
+    if (daemonIsRunning(socketPath)) {
+        cerr << "Another POS daemon is already serving " << socketPath << "\n";
+        return false;
+    }
+    unlink(socketPath.c_str());
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 128) != 0) {
+        cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+        if (listenFd >= 0) close(listenFd);
+        return false;
+    }
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+
+    int flushPipe[2];
+    if (pipe(flushPipe) != 0) {
+        cerr << "Cannot create the journal notification pipe: " << strerror(errno) << "\n";
+        close(listenFd);
+        return false;
+    }
+    for (int fd : flushPipe) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    journal.setFlushNotify(flushPipe[1]);
+
+    signal(SIGINT, onDaemonSignal);
+    signal(SIGTERM, onDaemonSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    cout << "[System] POS daemon listening on " << socketPath << "\n";
+
+    vector<DaemonClient> clients;
+    vector<pollfd> fds;
+    char buf[4096];
+
+    while (!daemonStopping) {
+        fds.clear();
+        fds.push_back({ listenFd, POLLIN, 0 });
+        fds.push_back({ flushPipe[0], POLLIN, 0 });
+        for (const auto& c : clients) {
+            short events = (c.closing || c.session.heldCommit) ? 0 : POLLIN;
+            if (!c.out.empty()) events |= POLLOUT;
+            fds.push_back({ c.fd, events, 0 });
+        }
+
+        int ready = poll(fds.data(), fds.size(), 1000);
+        if (ready < 0 && errno != EINTR) break;
+        maybeDumpMetrics();
+        if (ready <= 0) continue;
+
+        if (fds[1].revents & POLLIN) {
+            while (read(flushPipe[0], buf, sizeof(buf)) > 0) {}
+        }
+        releaseHeldReplies(clients);
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                DaemonClient c;
+                c.fd = fd;
+                c.session.deferCommits = true;
+                clients.push_back(move(c));
+            }
+        }
+
+        // fds[i + 2] belongs to clients[i]; clients accepted above are polled next round
+        size_t polled = fds.size() - 2;
+        for (size_t i = 0; i < polled; i++) {
+            DaemonClient& c = clients[i];
+            short rev = fds[i + 2].revents;
+            bool drop = (rev & (POLLERR | POLLNVAL)) != 0;
+
+            if (!drop && (rev & (POLLIN | POLLHUP)) && !c.closing) {
+                ssize_t n = read(c.fd, buf, sizeof(buf));
+                if (n > 0) {
+                    c.in.append(buf, (size_t)n);
+                    serveBufferedRequests(c);
+                    if (c.in.size() > MAX_REQUEST_LINE && c.in.find('\n') == string::npos) {
+                        c.out += "ERR request too long\n";
+                        c.closing = true;
+                    }
+                }
+                else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    drop = true;
+                }
+            }
+
+            if (!drop && !c.out.empty()) {
+                ssize_t n = write(c.fd, c.out.data(), c.out.size());
+                if (n > 0) c.out.erase(0, (size_t)n);
+                else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) drop = true;
+            }
+
+            if (drop || (c.closing && c.out.empty())) {
+                close(c.fd);
+                c.fd = -1;
+            }
         }
+        clients.erase(remove_if(clients.begin(), clients.end(),
+            [](const DaemonClient& c) { return c.fd < 0; }), clients.end());
+    }
+
+    journal.setFlushNotify(-1);
+    close(flushPipe[0]);
+    close(flushPipe[1]);
+    for (auto& c : clients) close(c.fd);
+    close(listenFd);
+    unlink(socketPath.c_str());
+    cout << "[System] POS daemon stopped.\n";
+    return true;
+}
+
+// Thin terminal: sends each stdin line to the daemon and prints the answer
+bool runClient(const string& socketPath) {
+    sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || !fillSocketAddress(socketPath, addr) || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        cerr << "Cannot reach the POS daemon at " << socketPath << "\n";
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    bool interactive = isatty(STDIN_FILENO);
+    string line, pending;
+    char buf[4096];
+    while (true) {
+        if (interactive) cout << "pos> " << flush;
+        if (!getline(cin, line)) break;
+        line = trimCopy(line);
+        if (line.empty()) continue;
+
+        line += "\n";
+        if (write(fd, line.data(), line.size()) != (ssize_t)line.size()) break;
+
+        // Exactly one answer line per request
+        size_t nl;
+        while ((nl = pending.find('\n')) == string::npos) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) { close(fd); return true; }
+            pending.append(buf, (size_t)n);
+        }
+        cout << pending.substr(0, nl) << "\n";
+        pending.erase(0, nl + 1);
+        if (startsWith(line, "QUIT") || startsWith(line, "quit")) break;
+    }
+    close(fd);
+    return true;
+}
+#else
+bool daemonIsRunning(const string&) {
+    return false;
+}
 
-    } while (adminChoice != 8);
+bool runDaemon(const string&) {
+    cerr << "Daemon mode needs Unix domain sockets and is not available on this platform.\n";
+    return false;
+}
+
+bool runClient(const string&) {
+    cerr << "Daemon mode needs Unix domain sockets and is not available on this platform.\n";
+    return false;
 }
+#endif
 
 // ================= MAIN =================
-int main() {
+#ifndef POS_NO_MAIN // bench/ builds include this file with their own main
+int main(int argc, char** argv) {
+    vector<string> replayPaths;
+    bool replayPersist = false, replayVerbose = false;
+    string daemonSocket, clientSocket;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (startsWith(arg, "--report-threads=")) reportThreads = max(0, atoi(arg.c_str() + 17));
+        else if (startsWith(arg, "--group-commit-ms=")) journal.groupCommitMs = max(0, atoi(arg.c_str() + 18));
+        else if (startsWith(arg, "--replay=")) replayPaths.push_back(arg.substr(9));
+        else if (arg == "--replay-persist") replayPersist = true;
+        else if (arg == "--verbose") replayVerbose = true;
+        else if (arg == "--daemon") daemonSocket = DEFAULT_SOCKET;
+        else if (startsWith(arg, "--daemon=")) daemonSocket = arg.substr(9);
+        else if (arg == "--client") clientSocket = DEFAULT_SOCKET;
+        else if (startsWith(arg, "--client=")) clientSocket = arg.substr(9);
+    }
+
+    if (!clientSocket.empty()) return runClient(clientSocket) ? 0 : 1;
+
+    // Every mode that writes the data files needs the directory to itself
+    bool writesData = !daemonSocket.empty() || replayPaths.empty() || replayPersist;
+    if (writesData && !lockDataDirectory()) {
+        cerr << "Another POS process (a daemon, console or persisting replay) is using the data in this directory.\n"
+            << "Connect to a daemon with --client instead.\n";
+        return 1;
+    }
+
+    if (!daemonSocket.empty()) {
+        if (daemonIsRunning(daemonSocket)) {
+            cerr << "Another POS daemon is already serving " << daemonSocket << "\n";
+            return 1;
+        }
+        loadData();
+        if (!runDaemon(daemonSocket)) return 1;
+        checkpoint();
+        dumpMetrics();
+        return 0;
+    }
+
+    if (!replayPaths.empty()) {
+        // Replays leave the data files alone unless asked to keep the result
+        persistenceEnabled = replayPersist;
+        loadData();
+        if (!runReplay(replayPaths, replayVerbose)) return 1;
+        if (replayPersist) checkpoint();
+        return 0;
+    }
+
     loadData();
     displayIntro();
 
@@ -1615,28 +5715,30 @@ int main() {
         cout << "  [11] Admin Login\n";
         cout << "  [12] Exit (Save & Close)\n";
         cout << "=============================================\n";
-        cout << "  BILL: RM " << fixed << setprecision(2) << currentCartTotal << "\n";
+        cout << "  BILL: RM " << moneyString(currentSession->cartCents) << "\n";
         cout << "  Choice: ";
 
         if (!(cin >> choice)) { clearBadInput(); continue; }
 
         switch (choice) {
-        case 1: applyMembership(); pause(); break;
-        case 2: facilityInfo(); pause(); break;
-        case 3: bookFacility(); pause(); break;
-        case 4: rentEquipment(); pause(); break;
-        case 5: buyMerchandiseSnacks(); pause(); break;
-        case 6: lockerRental(); pause(); break;
-        case 7: checkoutPayment(); pause(); break;
-        case 8: customerRefund(); pause(); break;
-        case 9: clearCart(); pause(); break;
-        case 10: feedback(); pause(); break;
+        case 1: applyMembership(); pauseScreen(); break;
+        case 2: facilityInfo(); pauseScreen(); break;
+        case 3: bookFacility(); pauseScreen(); break;
+        case 4: rentEquipment(); pauseScreen(); break;
+        case 5: buyMerchandiseSnacks(); pauseScreen(); break;
+        case 6: lockerRental(); pauseScreen(); break;
+        case 7: checkoutPayment(); pauseScreen(); break;
+        case 8: customerRefund(); pauseScreen(); break;
+        case 9: clearCart(); pauseScreen(); break;
+        case 10: feedback(); pauseScreen(); break;
         case 11: adminStaffLogin(); break;
-        case 12: saveData(); cout << "Exiting...\n"; break;
-        default: cout << "Invalid choice.\n"; pause(); break;
+        case 12: checkpoint(); dumpMetrics(); cout << "Exiting...\n"; break;
+        default: cout << "Invalid choice.\n"; pauseScreen(); break;
         }
+        maybeDumpMetrics();
 
     } while (choice != 12);
 
     return 0;
 }
+#endif
@@ -0,0 +1,163 @@
+// Crash-recovery checks for the transaction journal (Linux/macOS).
+//
+//   g++ -std=c++17 -O2 -pthread tests/journal_recovery.cpp -o journal_recovery
+//   ./journal_recovery [--dir=PATH]
+//
+// Prints one PASS/FAIL line per check and exits non-zero if any failed. The
+// "crash" is a forked child that calls _exit at the chosen point, so nothing
+// after it (destructors, the journal truncate) runs. Data files go to --dir
+// (default: <temp>/pos_journal_recovery), which is emptied first.
+
+#define POS_NO_MAIN
+#include "../src/main.cpp"
+
+#include <sys/wait.h>
+
+namespace recovery {
+
+ostream* results = nullptr;
+int failures = 0;
+
+void check(const string& name, bool ok, const string& detail) {
+    *results << (ok ? "PASS " : "FAIL ") << name;
+    if (!ok) *results << ": " << detail;
+    *results << "\n";
+    results->flush();
+    if (!ok) failures++;
+}
+
+// Forget everything in memory, as a fresh process would
+void resetStore() {
+    members.clear();
+    inventory.clear();
+    allBookings.clear();
+    bookingSegments.clear();
+    feedbackList.clear();
+    otherItemNames.clear();
+    consoleSession.cartItems.clear();
+    consoleSession.cartCents = 0;
+    journalRecords = 0;
+    nextBookingID = 1001;
+}
+
+void reload() {
+    resetStore();
+    loadData();
+}
+
+// Runs body in a child process that dies right after it
+template <typename Fn>
+bool crashAfter(Fn&& body) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        body();
+        _exit(0);
+    }
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int sell(int productId, int qty) {
+    BookingRecord b;
+    if (buyProduct(productId, qty) != BuyResult::Ok) return -1;
+    if (commitCheckout("Test", "0123456789", consoleSession.cartCents, b) != CheckoutResult::Ok) return -1;
+    return b.bookingID;
+}
+
+void addFeedback(const string& line) {
+    feedbackList.push_back(line);
+    journalFeedback(feedbackList.size() - 1, line);
+    journalSync();
+}
+
+size_t liveBookings() {
+    size_t live = 0;
+    for (const auto& b : allBookings) live += !b.cancelled;
+    return live;
+}
+
+int stockOf(int productId) {
+    const Product* p = findProduct(productId);
+    return p ? p->stock : -1;
+}
+
+// The data files are saved but the journal still holds every record in them:
+// replaying it on top must not restock a refund or add a feedback line twice
+void crashBetweenSaveAndTruncate() {
+    reload();
+    checkpoint();
+    int productId = inventory.at(0).id;
+    int stock = stockOf(productId);
+
+    bool ran = crashAfter([&] {
+        int refunded = sell(productId, 2);
+        if (refunded < 0 || refundBooking(refunded) != RefundResult::Ok) _exit(1);
+        if (sell(productId, 1) < 0) _exit(1);
+        addFeedback("Rating: 5 | first");
+        // checkpoint() up to the truncate
+        journal.drain();
+        compactBookings();
+        if (!saveData()) _exit(1);
+        writeSnapshot();
+    });
+    check("crash_after_save_child", ran, "child did not get to the save");
+
+    for (int pass = 1; pass <= 2; pass++) {
+        reload();
+        string when = " (load " + to_string(pass) + ")";
+        check("refund_restock_once" + when, stockOf(productId) == stock - 1,
+            "stock " + to_string(stockOf(productId)) + ", expected " + to_string(stock - 1));
+        check("feedback_once" + when, feedbackList.size() == 1,
+            to_string(feedbackList.size()) + " feedback lines");
+        check("sale_kept_refund_dropped" + when, liveBookings() == 1,
+            to_string(liveBookings()) + " live bookings");
+    }
+}
+
+// A record cut short by a crash must not swallow the records appended after it
+void tornTail() {
+    reload();
+    checkpoint();
+    size_t lines = feedbackList.size();
+    addFeedback("Rating: 4 | before");
+    {
+        ofstream out(FILE_JOURNAL, ios::app | ios::binary);
+        out << "SALE\n" << nextBookingID << "\n"; // the rest never made it
+    }
+
+    reload();
+    check("torn_record_skipped", feedbackList.size() == lines + 1, to_string(feedbackList.size()) + " feedback lines");
+    addFeedback("Rating: 3 | after");
+
+    reload();
+    check("append_after_torn_tail", feedbackList.size() == lines + 2 && feedbackList.back() == "Rating: 3 | after",
+        to_string(feedbackList.size()) + " feedback lines");
+}
+
+} // namespace recovery
+
+int main(int argc, char** argv) {
+    string dirArg;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (startsWith(arg, "--dir=")) dirArg = arg.substr(6);
+        else {
+            cerr << "Unknown option: " << arg << "\n";
+            return 2;
+        }
+    }
+
+    filesystem::path dir = dirArg.empty() ? filesystem::temp_directory_path() / "pos_journal_recovery" : filesystem::path(dirArg);
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    filesystem::current_path(dir);
+
+    // Results go to stdout; the POS code's own console output is dropped
+    ostream out(cout.rdbuf());
+    recovery::results = &out;
+    cout.rdbuf(nullptr);
+
+    recovery::crashBetweenSaveAndTruncate();
+    recovery::tornTail();
+    return recovery::failures == 0 ? 0 : 1;
+}